@@ -1,6 +1,12 @@
 #include <benchmark/benchmark.h>
+#include <erased/closed.h>
 #include <erased/erased.h>
+#include <erased/poly_vector.h>
+#include <erased/ref.h>
+#include <erased/span_ref.h>
 #include <memory>
+#include <memory_resource>
+#include <span>
 
 namespace er {
 struct ComputeArea {
@@ -54,6 +60,14 @@ template <typename... Ts> auto createSurfaces() {
   return std::array{Surface(Ts())...};
 }
 
+using PmrSurface = erased::erased<ComputeArea, Perimeter, erased::Move,
+                                  erased::pmr_allocator>;
+
+template <typename... Ts>
+auto createSurfaces(std::pmr::memory_resource *resource) {
+  return std::array{PmrSurface(std::allocator_arg, resource, Ts())...};
+}
+
 auto createLotSurfaces() {
   std::vector<Surface> surfaces;
   for (int i = 0; i < 1000; ++i)
@@ -61,6 +75,90 @@ auto createLotSurfaces() {
   return surfaces;
 }
 
+auto createLotMixedSurfaces() {
+  std::vector<Surface> surfaces;
+  for (int i = 0; i < 500; ++i) {
+    surfaces.emplace_back(std::in_place_type<Circle>);
+    surfaces.emplace_back(std::in_place_type<Rectangle>);
+  }
+  return surfaces;
+}
+
+using ClosedSurface = erased::closed<erased::type_list<Circle, Rectangle>,
+                                     ComputeArea, Perimeter, erased::Move>;
+
+auto createLotMixedClosedSurfaces() {
+  std::vector<ClosedSurface> surfaces;
+  for (int i = 0; i < 500; ++i) {
+    surfaces.emplace_back(std::in_place_type<Circle>);
+    surfaces.emplace_back(std::in_place_type<Rectangle>);
+  }
+  return surfaces;
+}
+
+using CompactSurface =
+    erased::erased<ComputeArea, Perimeter, erased::Move, erased::compact<>>;
+
+// A surface next to a flag: 64 bytes with the default 32 bytes alignment,
+// 40 bytes with the compact storage
+template <typename Erased> struct Shape {
+  Erased surface;
+  bool visible = true;
+};
+
+template <typename Erased> auto createLotShapes(std::size_t count) {
+  std::vector<Shape<Erased>> shapes;
+  shapes.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (i % 2)
+      shapes.push_back({Erased(Circle{})});
+    else
+      shapes.push_back({Erased(Rectangle{})});
+  }
+  return shapes;
+}
+
+using SurfaceRef = erased::ref<ComputeArea, Perimeter>;
+using InlineSurfaceRef =
+    erased::ref<ComputeArea, Perimeter, erased::inline_vtable<>>;
+
+template <typename Ref> auto createLotRefs(std::vector<Circle> &circles) {
+  return std::vector<Ref>(circles.begin(), circles.end());
+}
+
+// Same as ComputeArea, with a loop over the circles written by hand
+struct BatchComputeArea {
+  constexpr static double invoker(const auto &self) {
+    return self.computeArea();
+  }
+
+  static void batch_invoker(std::span<const Circle> circles,
+                            std::span<double> areas) {
+    for (std::size_t i = 0; i < circles.size(); ++i)
+      areas[i] = circles[i].m_radius * circles[i].m_radius * 3.14;
+  }
+};
+
+using SurfaceSpan = erased::span_ref<ComputeArea, BatchComputeArea>;
+
+using SurfaceVector = erased::poly_vector<ComputeArea, Perimeter>;
+
+auto createLotPolySurfaces() {
+  SurfaceVector surfaces;
+  for (int i = 0; i < 1000; ++i)
+    surfaces.emplace_back<Circle>();
+  return surfaces;
+}
+
+auto createLotMixedPolySurfaces() {
+  SurfaceVector surfaces;
+  for (int i = 0; i < 500; ++i) {
+    surfaces.emplace_back<Circle>();
+    surfaces.emplace_back<Rectangle>();
+  }
+  return surfaces;
+}
+
 } // namespace er
 
 namespace vt {
@@ -113,6 +211,15 @@ template <typename... Ts> void testConstructErased(benchmark::State &state) {
     benchmark::DoNotOptimize(er::createSurfaces<Ts...>());
 }
 
+template <typename... Ts>
+void testConstructErasedArena(benchmark::State &state) {
+  std::array<std::byte, 4096> buffer;
+  for (auto &&_ : state) {
+    std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size()};
+    benchmark::DoNotOptimize(er::createSurfaces<Ts...>(&arena));
+  }
+}
+
 template <typename... Ts> void testConstructVTable(benchmark::State &state) {
   for (auto &&_ : state)
     benchmark::DoNotOptimize(vt::createSurfaces<Ts...>());
@@ -144,6 +251,86 @@ void testCallLotErased(benchmark::State &state) {
   }
 }
 
+void testCallLotMixedErased(benchmark::State &state) {
+  auto surfaces = er::createLotMixedSurfaces();
+  for (auto &&_ : state) {
+    for (auto &&surface : surfaces)
+      benchmark::DoNotOptimize(surface.computeArea() + surface.perimeter());
+  }
+}
+
+void testCallLotMixedClosed(benchmark::State &state) {
+  auto surfaces = er::createLotMixedClosedSurfaces();
+  for (auto &&_ : state) {
+    for (auto &&surface : surfaces)
+      benchmark::DoNotOptimize(surface.computeArea() + surface.perimeter());
+  }
+}
+
+template <typename Ref> void testCallLotRef(benchmark::State &state) {
+  std::vector<er::Circle> circles(1000);
+  auto surfaces = er::createLotRefs<Ref>(circles);
+  for (auto &&_ : state) {
+    for (auto &&surface : surfaces)
+      benchmark::DoNotOptimize(surface.computeArea() + surface.perimeter());
+  }
+}
+
+template <auto create> void testCallLotPolyVector(benchmark::State &state) {
+  auto surfaces = create();
+  std::vector<double> areas(surfaces.size());
+  std::vector<double> perimeters(surfaces.size());
+  for (auto &&_ : state) {
+    surfaces.transform(er::ComputeArea{}, areas.data());
+    surfaces.transform(er::Perimeter{}, perimeters.data());
+    benchmark::DoNotOptimize(areas.data());
+    benchmark::DoNotOptimize(perimeters.data());
+    benchmark::ClobberMemory();
+  }
+}
+
+template <typename Method> void testCallLotSpan(benchmark::State &state) {
+  std::vector<er::Circle> circles(1000);
+  er::SurfaceSpan surfaces = circles;
+  std::vector<double> areas(circles.size());
+  for (auto &&_ : state) {
+    surfaces.transform(Method{}, areas.data());
+    benchmark::DoNotOptimize(areas.data());
+    benchmark::ClobberMemory();
+  }
+}
+
+// Reallocations relocate the inline surfaces bytewise and steal the heap ones
+template <typename... Ts> void testGrowErased(benchmark::State &state) {
+  for (auto &&_ : state) {
+    std::vector<er::Surface> surfaces;
+    for (int i = 0; i < 1000; ++i)
+      (surfaces.emplace_back(std::in_place_type<Ts>), ...);
+    benchmark::DoNotOptimize(surfaces.data());
+  }
+}
+
+template <typename... Ts> void testGrowVTable(benchmark::State &state) {
+  for (auto &&_ : state) {
+    std::vector<std::unique_ptr<vt::ISurface>> surfaces;
+    for (int i = 0; i < 1000; ++i)
+      (surfaces.push_back(std::make_unique<Ts>()), ...);
+    benchmark::DoNotOptimize(surfaces.data());
+  }
+}
+
+// Working sets from L1 to main memory
+template <typename Erased> void testCallShapes(benchmark::State &state) {
+  auto shapes = er::createLotShapes<Erased>(state.range(0));
+  for (auto &&_ : state) {
+    for (auto &&shape : shapes)
+      if (shape.visible)
+        benchmark::DoNotOptimize(shape.surface.computeArea());
+  }
+  state.counters["bytes"] = sizeof(er::Shape<Erased>) * shapes.size();
+  state.SetItemsProcessed(state.iterations() * shapes.size());
+}
+
 void testCallLotVTable(benchmark::State &state) {
   auto surfaces = vt::createLotSurfaces();
   for (auto &&_ : state) {
@@ -158,11 +345,29 @@ BENCHMARK(testCallErased<er::Circle, er::Rectangle>);
 BENCHMARK(testCallVTable<vt::Circle, vt::Rectangle>);
 
 BENCHMARK(testConstructErased<er::BigCircle, er::BigRectangle>);
+BENCHMARK(testConstructErasedArena<er::BigCircle, er::BigRectangle>);
 BENCHMARK(testConstructVTable<vt::BigCircle, vt::BigRectangle>);
 BENCHMARK(testCallErased<er::BigCircle, er::BigRectangle>);
 BENCHMARK(testCallVTable<vt::BigCircle, vt::BigRectangle>);
 
 BENCHMARK(testCallLotErased);
 BENCHMARK(testCallLotVTable);
+BENCHMARK(testCallLotPolyVector<er::createLotPolySurfaces>);
+BENCHMARK(testCallLotRef<er::SurfaceRef>);
+BENCHMARK(testCallLotRef<er::InlineSurfaceRef>);
+BENCHMARK(testCallLotSpan<er::ComputeArea>);
+BENCHMARK(testCallLotSpan<er::BatchComputeArea>);
+
+BENCHMARK(testCallLotMixedErased);
+BENCHMARK(testCallLotMixedClosed);
+BENCHMARK(testCallLotPolyVector<er::createLotMixedPolySurfaces>);
+
+BENCHMARK(testCallShapes<er::Surface>)->Range(1 << 8, 1 << 20);
+BENCHMARK(testCallShapes<er::CompactSurface>)->Range(1 << 8, 1 << 20);
+
+BENCHMARK(testGrowErased<er::Circle, er::Rectangle>);
+BENCHMARK(testGrowVTable<vt::Circle, vt::Rectangle>);
+BENCHMARK(testGrowErased<er::BigCircle, er::BigRectangle>);
+BENCHMARK(testGrowVTable<vt::BigCircle, vt::BigRectangle>);
 
 BENCHMARK_MAIN();
@@ -0,0 +1,118 @@
+#include "suite.h"
+#include <benchmark/benchmark.h>
+#include <erased/invoke_all.h>
+#include <erased/ref.h>
+#include <vector>
+
+// Calls over count objects drawn among Kinds types in a random order:
+// 1 is monomorphic, 2 polymorphic and 8 megamorphic. The largest working
+// sets do not fit in the last level cache.
+template <template <typename> typename Holder, template <int> typename Shape,
+          std::size_t Kinds>
+void testCallSite(benchmark::State &state) {
+  using family = suite::family<Shape>;
+  using holder = Holder<family>;
+  const auto count = static_cast<std::size_t>(state.range(0));
+  auto objects = suite::make_objects<holder>(count, Kinds, family{});
+
+  for (auto &&_ : state) {
+    double sum = 0.0;
+    for (const auto &object : objects)
+      sum += holder::call(object);
+    benchmark::DoNotOptimize(sum);
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+  state.counters["bytes"] = sizeof(typename holder::type) * count;
+}
+
+// Same call sites as testCallSite<suite::erased_holder, ...>, batched by
+// erased::invoke_all_into: grouped by vtable, with or without prefetching.
+template <template <int> typename Shape, std::size_t Kinds, bool Prefetch>
+void testInvokeAll(benchmark::State &state) {
+  using family = suite::family<Shape>;
+  using holder = suite::erased_holder<family>;
+  const auto count = static_cast<std::size_t>(state.range(0));
+  auto objects = suite::make_objects<holder>(count, Kinds, family{});
+  std::vector<double> results(count);
+
+  for (auto &&_ : state) {
+    erased::invoke_all_into<Prefetch>(objects, suite::ComputeArea{},
+                                      results.begin());
+    benchmark::DoNotOptimize(results.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+// Refs to erased objects of Holder. Without a view entry, the ref points at
+// the erased object and each call goes through both vtables; with one, the ref
+// points at the object stored inside.
+template <typename Family> struct view_holder {
+  using type = erased::erased<suite::ComputeArea, erased::Copy, erased::Move,
+                              erased::view<erased::ref<suite::ComputeArea>>>;
+
+  template <typename T> static type make() { return T{}; }
+};
+
+template <template <typename> typename Holder, template <int> typename Shape,
+          std::size_t Kinds>
+void testRefToErased(benchmark::State &state) {
+  using family = suite::family<Shape>;
+  using holder = Holder<family>;
+  const auto count = static_cast<std::size_t>(state.range(0));
+  auto objects = suite::make_objects<holder>(count, Kinds, family{});
+  const std::vector<erased::ref<suite::ComputeArea>> refs(objects.begin(),
+                                                          objects.end());
+
+  for (auto &&_ : state) {
+    double sum = 0.0;
+    for (const auto &ref : refs)
+      sum += ref.invoke(suite::ComputeArea{});
+    benchmark::DoNotOptimize(sum);
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+#define ERASED_INVOKE_ALL(Shape, Prefetch)                                     \
+  BENCHMARK(testInvokeAll<Shape, 1, Prefetch>)->Range(1 << 8, 1 << 20);        \
+  BENCHMARK(testInvokeAll<Shape, 2, Prefetch>)->Range(1 << 8, 1 << 20);        \
+  BENCHMARK(testInvokeAll<Shape, 8, Prefetch>)->Range(1 << 8, 1 << 20)
+
+#define ERASED_CALL_SITES(Holder, Shape)                                       \
+  BENCHMARK(testCallSite<Holder, Shape, 1>)->Range(1 << 8, 1 << 20);           \
+  BENCHMARK(testCallSite<Holder, Shape, 2>)->Range(1 << 8, 1 << 20);           \
+  BENCHMARK(testCallSite<Holder, Shape, 8>)->Range(1 << 8, 1 << 20)
+
+#define ERASED_REFS_TO_ERASED(Holder)                                          \
+  BENCHMARK(testRefToErased<Holder, suite::Small, 2>)->Range(1 << 8, 1 << 20); \
+  BENCHMARK(testRefToErased<Holder, suite::Small, 8>)->Range(1 << 8, 1 << 20)
+
+#define ERASED_ALL_CALL_SITES(Shape)                                           \
+  ERASED_CALL_SITES(suite::erased_holder, Shape);                              \
+  ERASED_CALL_SITES(suite::compact_holder, Shape);                             \
+  ERASED_CALL_SITES(suite::shared_holder, Shape);                              \
+  ERASED_CALL_SITES(suite::closed_holder, Shape);                              \
+  ERASED_CALL_SITES(suite::virtual_holder, Shape);                             \
+  ERASED_CALL_SITES(suite::function_holder, Shape);                            \
+  ERASED_CALL_SITES(suite::erased_function_holder, Shape);                     \
+  ERASED_CALL_SITES(suite::erased_move_only_function_holder, Shape);           \
+  ERASED_CALL_SITES(suite::any_holder, Shape);                                 \
+  ERASED_CALL_SITES(suite::variant_holder, Shape)
+
+ERASED_ALL_CALL_SITES(suite::Small);
+ERASED_ALL_CALL_SITES(suite::Big);
+
+ERASED_INVOKE_ALL(suite::Small, false);
+ERASED_INVOKE_ALL(suite::Small, true);
+ERASED_INVOKE_ALL(suite::Big, false);
+ERASED_INVOKE_ALL(suite::Big, true);
+
+ERASED_REFS_TO_ERASED(suite::erased_holder);
+ERASED_REFS_TO_ERASED(view_holder);
+
+#ifdef __cpp_lib_move_only_function
+ERASED_CALL_SITES(suite::move_only_function_holder, suite::Small);
+ERASED_CALL_SITES(suite::move_only_function_holder, suite::Big);
+#endif
@@ -0,0 +1,58 @@
+# Compiles compile_time.cpp once per configuration and reports the time and,
+# when GNU time is available, the peak memory of the compiler.
+#
+# Run by the CompileTimeBenchmarks target with:
+#   COMPILER       the C++ compiler
+#   FLAGS          its flags, such as the standard version
+#   INCLUDE_DIR    the include directory of erased
+#   SOURCE         compile_time.cpp
+#   OUTPUT_DIR     where the objects and compile_times.csv are written
+#   CONFIGURATIONS list of BEHAVIORSxTYPESxINTERFACES, e.g. 8x8x8
+
+find_program(GNU_TIME time)
+if(GNU_TIME)
+    execute_process(COMMAND ${GNU_TIME} --version
+        OUTPUT_VARIABLE time_version ERROR_VARIABLE time_version)
+    if(NOT time_version MATCHES "GNU")
+        unset(GNU_TIME)
+    endif()
+endif()
+
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+set(csv "behaviors,types,interfaces,milliseconds,peak_kilobytes\n")
+message("behaviors types interfaces milliseconds peak_kilobytes")
+
+foreach(configuration IN LISTS CONFIGURATIONS)
+    string(REPLACE "x" ";" values ${configuration})
+    list(GET values 0 behaviors)
+    list(GET values 1 types)
+    list(GET values 2 interfaces)
+
+    set(object ${OUTPUT_DIR}/compile_time_${configuration}.o)
+    set(command ${COMPILER} ${FLAGS} -I${INCLUDE_DIR}
+        -DERASED_BEHAVIORS=${behaviors} -DERASED_TYPES=${types}
+        -DERASED_INTERFACES=${interfaces} -c ${SOURCE} -o ${object})
+    if(GNU_TIME)
+        set(memory_file ${OUTPUT_DIR}/compile_time_${configuration}.memory)
+        set(command ${GNU_TIME} -f %M -o ${memory_file} ${command})
+    endif()
+
+    string(TIMESTAMP start "%s%f")
+    execute_process(COMMAND ${command} RESULT_VARIABLE result)
+    string(TIMESTAMP end "%s%f")
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Compiling ${configuration} failed")
+    endif()
+    math(EXPR milliseconds "(${end} - ${start}) / 1000")
+
+    set(peak "n/a")
+    if(GNU_TIME)
+        file(STRINGS ${memory_file} peak LIMIT_COUNT 1)
+    endif()
+
+    message("${behaviors} ${types} ${interfaces} ${milliseconds} ${peak}")
+    string(APPEND csv
+        "${behaviors},${types},${interfaces},${milliseconds},${peak}\n")
+endforeach()
+
+file(WRITE ${OUTPUT_DIR}/compile_times.csv ${csv})
@@ -0,0 +1,74 @@
+#include <cstddef>
+#include <erased/erased.h>
+#include <erased/ref.h>
+#include <utility>
+
+// Synthetic translation unit compiled by the CompileTimeBenchmarks target:
+// ERASED_INTERFACES erased types of ERASED_BEHAVIORS behaviors each, every
+// behavior being called on ERASED_TYPES concrete types. Only its compilation
+// is measured.
+#ifndef ERASED_BEHAVIORS
+#define ERASED_BEHAVIORS 8
+#endif
+
+#ifndef ERASED_TYPES
+#define ERASED_TYPES 8
+#endif
+
+#ifndef ERASED_INTERFACES
+#define ERASED_INTERFACES 8
+#endif
+
+namespace {
+template <std::size_t Interface, std::size_t I> struct Behavior {
+  constexpr static std::size_t invoker(const auto &self) {
+    return self.template value<I>();
+  }
+};
+
+template <std::size_t J> struct Type {
+  template <std::size_t I> constexpr std::size_t value() const {
+    return I * J + m_offset;
+  }
+
+  std::size_t m_offset = 0;
+};
+
+template <std::size_t Interface, typename Behaviors> struct interface;
+
+template <std::size_t Interface, std::size_t... Is>
+struct interface<Interface, std::index_sequence<Is...>> {
+  using type = erased::erased<Behavior<Interface, Is>..., erased::Copy,
+                              erased::Move>;
+  using ref_type = erased::ref<Behavior<Interface, Is>...>;
+
+  static std::size_t call_all(const type &object) {
+    return (object.invoke(Behavior<Interface, Is>{}) + ...);
+  }
+
+  static std::size_t call_ref(ref_type object) {
+    return (object.invoke(Behavior<Interface, Is>{}) + ...);
+  }
+};
+
+template <std::size_t Interface, std::size_t... Js>
+std::size_t use_interface(std::index_sequence<Js...>) {
+  using interface =
+      interface<Interface, std::make_index_sequence<ERASED_BEHAVIORS>>;
+  std::size_t sum = 0;
+  ((sum += interface::call_all(typename interface::type{Type<Js>{}})), ...);
+  Type<0> object;
+  return sum + interface::call_ref(object);
+}
+
+template <std::size_t... Interfaces>
+std::size_t use_interfaces(std::index_sequence<Interfaces...>) {
+  return (use_interface<Interfaces>(std::make_index_sequence<ERASED_TYPES>{}) +
+          ...);
+}
+} // namespace
+
+int main() {
+  return static_cast<int>(
+      use_interfaces(std::make_index_sequence<ERASED_INTERFACES>{}) % 2);
+}
@@ -0,0 +1,61 @@
+#include "suite.h"
+#include <benchmark/benchmark.h>
+#include <erased/atomic_erased.h>
+#include <mutex>
+
+// Reader threads call a shared strategy while, with Writes, the first thread
+// replaces it every 1024 calls.
+namespace {
+struct mutex_holder {
+  using type = erased::erased<suite::ComputeArea, erased::Move>;
+
+  template <typename T> mutex_holder(T x) : m_value{std::move(x)} {}
+
+  double call() const {
+    std::lock_guard lock{m_mutex};
+    return m_value.invoke(suite::ComputeArea{});
+  }
+
+  template <typename T> void store(T x) {
+    std::lock_guard lock{m_mutex};
+    m_value = std::move(x);
+  }
+
+  mutable std::mutex m_mutex;
+  type m_value;
+};
+
+struct atomic_holder {
+  using type = erased::atomic_erased<suite::ComputeArea>;
+
+  template <typename T> atomic_holder(T x) : m_value{std::move(x)} {}
+
+  double call() const { return m_value.invoke(suite::ComputeArea{}); }
+
+  template <typename T> void store(T x) { m_value.store(std::move(x)); }
+
+  type m_value;
+};
+
+template <typename Holder> Holder &strategy() {
+  static Holder holder{suite::Big<0>{}};
+  return holder;
+}
+} // namespace
+
+template <typename Holder, bool Writes>
+void testConcurrentRead(benchmark::State &state) {
+  auto &holder = strategy<Holder>();
+  std::size_t calls = 0;
+  for (auto &&_ : state) {
+    if (Writes && state.thread_index() == 0 && ++calls % 1024 == 0)
+      holder.store(suite::Big<1>{});
+    benchmark::DoNotOptimize(holder.call());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(testConcurrentRead<mutex_holder, false>)->ThreadRange(1, 8);
+BENCHMARK(testConcurrentRead<atomic_holder, false>)->ThreadRange(1, 8);
+BENCHMARK(testConcurrentRead<mutex_holder, true>)->ThreadRange(1, 8);
+BENCHMARK(testConcurrentRead<atomic_holder, true>)->ThreadRange(1, 8);
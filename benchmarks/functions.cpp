@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <erased/function.h>
+#include <functional>
+#include <utility>
+
+// A callback passed to an algorithm, the use case of function_ref. The
+// callback escapes before the loop, so that each call is an indirect call.
+template <typename Callback> void testCallback(benchmark::State &state) {
+  const auto count = static_cast<std::size_t>(state.range(0));
+  double total = 0.0;
+  auto accumulate = [&total](double value) { return total += value; };
+
+  for (auto &&_ : state) {
+    Callback callback = accumulate;
+    benchmark::DoNotOptimize(callback);
+    for (std::size_t i = 0; i < count; ++i)
+      benchmark::DoNotOptimize(callback(static_cast<double>(i)));
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+// Callbacks with two signatures, called alternately: a single erased object
+// against one std::function per signature.
+struct Accumulator {
+  double operator()(double value) const { return m_total + value; }
+  double operator()(double value, double weight) {
+    return m_total += value * weight;
+  }
+
+  double m_total = 0.0;
+};
+
+void testOverloadedFunction(benchmark::State &state) {
+  erased::function<double(double) const, double(double, double)> callback =
+      Accumulator{};
+  benchmark::DoNotOptimize(callback);
+  for (auto &&_ : state) {
+    benchmark::DoNotOptimize(callback(1.0, 2.0));
+    benchmark::DoNotOptimize(callback(1.0));
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+
+void testOverloadedStdFunctions(benchmark::State &state) {
+  Accumulator accumulator;
+  std::function<double(double)> unary = [&](double value) {
+    return std::as_const(accumulator)(value);
+  };
+  std::function<double(double, double)> binary = [&](double value,
+                                                     double weight) {
+    return accumulator(value, weight);
+  };
+  benchmark::DoNotOptimize(unary);
+  benchmark::DoNotOptimize(binary);
+  for (auto &&_ : state) {
+    benchmark::DoNotOptimize(binary(1.0, 2.0));
+    benchmark::DoNotOptimize(unary(1.0));
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+
+BENCHMARK(testCallback<erased::function_ref<double(double)>>)
+    ->Range(1 << 4, 1 << 12);
+BENCHMARK(testCallback<erased::function<double(double)>>)
+    ->Range(1 << 4, 1 << 12);
+BENCHMARK(testCallback<erased::move_only_function<double(double)>>)
+    ->Range(1 << 4, 1 << 12);
+BENCHMARK(testCallback<std::function<double(double)>>)->Range(1 << 4, 1 << 12);
+#ifdef __cpp_lib_move_only_function
+BENCHMARK(testCallback<std::move_only_function<double(double)>>)
+    ->Range(1 << 4, 1 << 12);
+#endif
+#ifdef __cpp_lib_function_ref
+BENCHMARK(testCallback<std::function_ref<double(double)>>)
+    ->Range(1 << 4, 1 << 12);
+#endif
+
+BENCHMARK(testOverloadedFunction);
+BENCHMARK(testOverloadedStdFunctions);
@@ -0,0 +1,166 @@
+#include "suite.h"
+#include <benchmark/benchmark.h>
+
+// Small shapes are stored inline by erased, std::function and std::any,
+// big ones go to the heap. The allocations per iteration are reported, and
+// moves, erased objects stored inline and erased assignments between objects
+// of the same type fail the benchmark when they allocate.
+template <template <typename> typename Holder, typename T>
+using holder_for = Holder<suite::type_list<T>>;
+
+template <template <typename> typename Holder, typename T>
+void testConstructDestroy(benchmark::State &state) {
+  using holder = holder_for<Holder, T>;
+  // Warms up the heap, such as the free lists of the pool
+  benchmark::DoNotOptimize(holder::template make<T>());
+  const suite::allocation_meter meter{
+      suite::allocation_budget<typename holder::type, T>()};
+  for (auto &&_ : state) {
+    auto object = holder::template make<T>();
+    benchmark::DoNotOptimize(object);
+  }
+  meter.report(state);
+}
+
+template <template <typename> typename Holder, typename T>
+void testCopy(benchmark::State &state) {
+  using holder = holder_for<Holder, T>;
+  const auto object = holder::template make<T>();
+  const suite::allocation_meter meter{
+      suite::allocation_budget<typename holder::type, T>()};
+  for (auto &&_ : state) {
+    auto copy = holder::copy(object);
+    benchmark::DoNotOptimize(copy);
+  }
+  meter.report(state);
+}
+
+template <template <typename> typename Holder, typename T>
+void testCopyAssign(benchmark::State &state) {
+  using holder = holder_for<Holder, T>;
+  const auto object = holder::template make<T>();
+  auto target = holder::template make<T>();
+  const suite::allocation_meter meter{
+      erased::is_erased_v<typename holder::type> ? 0 : suite::unlimited};
+  for (auto &&_ : state) {
+    if constexpr (std::is_copy_assignable_v<typename holder::type>)
+      target = object;
+    else
+      target = holder::copy(object);
+    benchmark::DoNotOptimize(target);
+  }
+  meter.report(state);
+}
+
+template <template <typename> typename Holder, typename T>
+void testMove(benchmark::State &state) {
+  using holder = holder_for<Holder, T>;
+  auto object = holder::template make<T>();
+  const suite::allocation_meter meter{0};
+  for (auto &&_ : state) {
+    auto moved = std::move(object);
+    object = std::move(moved);
+    benchmark::DoNotOptimize(object);
+  }
+  meter.report(state);
+}
+
+// Replaces the object by a new one of the same type
+template <template <typename> typename Holder, typename T>
+void testEmplace(benchmark::State &state) {
+  using holder = holder_for<Holder, T>;
+  auto target = holder::template make<T>();
+  const suite::allocation_meter meter{
+      erased::is_erased_v<typename holder::type> ? 0 : suite::unlimited};
+  for (auto &&_ : state) {
+    target.template emplace<T>();
+    benchmark::DoNotOptimize(target);
+  }
+  meter.report(state);
+}
+
+// Reallocations move every object already stored
+template <template <typename> typename Holder, typename T>
+void testGrow(benchmark::State &state) {
+  using holder = holder_for<Holder, T>;
+  const auto count = static_cast<std::size_t>(state.range(0));
+  const suite::allocation_meter meter;
+  for (auto &&_ : state) {
+    std::vector<typename holder::type> objects;
+    for (std::size_t i = 0; i < count; ++i)
+      objects.push_back(holder::template make<T>());
+    benchmark::DoNotOptimize(objects.data());
+  }
+  meter.report(state);
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+// An erased object handed to an interface taking fewer behaviors: wrapped in
+// the narrow type, or converted to it.
+using narrow_type = erased::erased<suite::ComputeArea, erased::Move>;
+using wide_type = erased::erased<suite::ComputeArea, erased::Copy, erased::Move,
+                                 erased::converts_to<narrow_type>>;
+
+template <typename T, bool Convert>
+void testNarrow(benchmark::State &state) {
+  for (auto &&_ : state) {
+    wide_type wide = T{};
+    if constexpr (Convert) {
+      narrow_type narrow = std::move(wide);
+      benchmark::DoNotOptimize(narrow);
+    } else {
+      narrow_type narrow{std::in_place_type<wide_type>, std::move(wide)};
+      benchmark::DoNotOptimize(narrow);
+    }
+  }
+}
+
+#define ERASED_MOVE_ONLY_LIFETIME(Holder, T)                                   \
+  BENCHMARK(testConstructDestroy<Holder, T>);                                  \
+  BENCHMARK(testMove<Holder, T>);                                              \
+  BENCHMARK(testGrow<Holder, T>)->Range(1 << 4, 1 << 16)
+
+#define ERASED_LIFETIME(Holder, T)                                             \
+  ERASED_MOVE_ONLY_LIFETIME(Holder, T);                                        \
+  BENCHMARK(testCopy<Holder, T>);                                              \
+  BENCHMARK(testCopyAssign<Holder, T>)
+
+#define ERASED_ALL_LIFETIMES(T)                                                \
+  ERASED_LIFETIME(suite::erased_holder, T);                                    \
+  ERASED_LIFETIME(suite::compact_holder, T);                                   \
+  ERASED_LIFETIME(suite::pooled_holder, T);                                    \
+  ERASED_LIFETIME(suite::shared_holder, T);                                    \
+  ERASED_LIFETIME(suite::closed_holder, T);                                    \
+  ERASED_LIFETIME(suite::virtual_holder, T);                                   \
+  ERASED_LIFETIME(suite::function_holder, T);                                  \
+  ERASED_LIFETIME(suite::erased_function_holder, T);                           \
+  ERASED_LIFETIME(suite::any_holder, T);                                       \
+  ERASED_LIFETIME(suite::variant_holder, T)
+
+ERASED_ALL_LIFETIMES(suite::Small<0>);
+ERASED_ALL_LIFETIMES(suite::Big<0>);
+
+ERASED_MOVE_ONLY_LIFETIME(suite::erased_move_only_function_holder,
+                          suite::Small<0>);
+ERASED_MOVE_ONLY_LIFETIME(suite::erased_move_only_function_holder,
+                          suite::Big<0>);
+
+#define ERASED_EMPLACE(T)                                                      \
+  BENCHMARK(testEmplace<suite::erased_holder, T>);                             \
+  BENCHMARK(testEmplace<suite::compact_holder, T>);                            \
+  BENCHMARK(testEmplace<suite::pooled_holder, T>);                             \
+  BENCHMARK(testEmplace<suite::any_holder, T>);                                \
+  BENCHMARK(testEmplace<suite::variant_holder, T>)
+
+ERASED_EMPLACE(suite::Small<0>);
+ERASED_EMPLACE(suite::Big<0>);
+
+BENCHMARK(testNarrow<suite::Small<0>, false>);
+BENCHMARK(testNarrow<suite::Small<0>, true>);
+BENCHMARK(testNarrow<suite::Big<0>, false>);
+BENCHMARK(testNarrow<suite::Big<0>, true>);
+
+#ifdef __cpp_lib_move_only_function
+ERASED_MOVE_ONLY_LIFETIME(suite::move_only_function_holder, suite::Small<0>);
+ERASED_MOVE_ONLY_LIFETIME(suite::move_only_function_holder, suite::Big<0>);
+#endif
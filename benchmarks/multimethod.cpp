@@ -0,0 +1,88 @@
+#include "suite.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <erased/multimethod.h>
+#include <vector>
+
+// Interactions of count pairs of shapes drawn among Kinds types: through the
+// table of erased::dispatch, or by finding both concrete types with chains of
+// erased::is and any_cast, as nested visitors would.
+namespace {
+template <typename Family> struct index_for;
+
+template <typename... Ts> struct index_for<suite::type_list<Ts...>> {
+  using type = erased::DispatchIndex<Ts...>;
+};
+
+template <typename Family> struct dispatch_holder {
+  using type =
+      erased::erased<suite::ComputeArea, typename index_for<Family>::type,
+                     erased::Copy, erased::Move>;
+
+  template <typename T> static type make() { return T{}; }
+};
+
+// Defined on every pair of shapes
+struct Overlap {
+  template <typename T, typename U>
+  static constexpr double invoker(const T &lhs, const U &rhs) {
+    return lhs.computeArea() - rhs.computeArea();
+  }
+
+  static constexpr double fallback() { return 0.0; }
+};
+
+template <typename Erased, typename F, typename... Ts>
+double visit_chain(const Erased &object, F f, suite::type_list<Ts...>) {
+  double result = 0.0;
+  (void)((erased::is<Ts>(object) &&
+          (result = f(*erased::any_cast<Ts>(&object)), true)) ||
+         ...);
+  return result;
+}
+
+template <typename Family, typename Erased>
+double nested_dispatch(const Erased &lhs, const Erased &rhs) {
+  return visit_chain(
+      lhs,
+      [&](const auto &left) {
+        return visit_chain(
+            rhs,
+            [&](const auto &right) { return Overlap::invoker(left, right); },
+            Family{});
+      },
+      Family{});
+}
+} // namespace
+
+template <std::size_t Kinds, bool Table>
+void testDoubleDispatch(benchmark::State &state) {
+  using family = suite::family<suite::Small>;
+  using holder = dispatch_holder<family>;
+  const auto count = static_cast<std::size_t>(state.range(0));
+  const auto lhs = suite::make_objects<holder>(count, Kinds, family{});
+  // Same draws, paired in the other order
+  auto rhs = suite::make_objects<holder>(count, Kinds, family{});
+  std::ranges::reverse(rhs);
+
+  for (auto &&_ : state) {
+    double sum = 0.0;
+    for (std::size_t i = 0; i < count; ++i) {
+      if constexpr (Table)
+        sum += erased::dispatch(Overlap{}, lhs[i], rhs[i]);
+      else
+        sum += nested_dispatch<family>(lhs[i], rhs[i]);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+BENCHMARK(testDoubleDispatch<1, false>)->Range(1 << 8, 1 << 16);
+BENCHMARK(testDoubleDispatch<1, true>)->Range(1 << 8, 1 << 16);
+BENCHMARK(testDoubleDispatch<2, false>)->Range(1 << 8, 1 << 16);
+BENCHMARK(testDoubleDispatch<2, true>)->Range(1 << 8, 1 << 16);
+BENCHMARK(testDoubleDispatch<8, false>)->Range(1 << 8, 1 << 16);
+BENCHMARK(testDoubleDispatch<8, true>)->Range(1 << 8, 1 << 16);
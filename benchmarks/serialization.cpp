@@ -0,0 +1,79 @@
+#include "suite.h"
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <erased/ref.h>
+#include <erased/serialization.h>
+#include <span>
+#include <vector>
+
+// Warm start of count objects from an archive, as if it was memory mapped:
+// loaded in erased objects, small shapes inline and big ones on the heap, or
+// viewed in place by refs.
+template <typename Family> struct registry_for;
+
+template <typename... Ts> struct registry_for<suite::type_list<Ts...>> {
+  using type = erased::type_registry<Ts...>;
+};
+
+template <template <int> typename Shape> struct archive_holder {
+  using family = suite::family<Shape>;
+  using registry = typename registry_for<family>::type;
+  using type =
+      erased::erased<suite::ComputeArea, erased::Serialize,
+                     erased::StableId<registry>, erased::Copy, erased::Move>;
+
+  template <typename T> static type make() { return T{}; }
+};
+
+template <template <int> typename Shape>
+std::vector<std::byte> make_archive(std::size_t count) {
+  using holder = archive_holder<Shape>;
+  std::vector<std::byte> archive;
+  for (const auto &object : suite::make_objects<holder>(
+           count, 8, typename holder::family{}))
+    holder::registry::save(object, archive);
+  return archive;
+}
+
+template <template <int> typename Shape>
+void testLoadArchive(benchmark::State &state) {
+  using holder = archive_holder<Shape>;
+  const auto count = static_cast<std::size_t>(state.range(0));
+  const auto archive = make_archive<Shape>(count);
+
+  for (auto &&_ : state) {
+    std::vector<typename holder::type> objects;
+    objects.reserve(count);
+    erased::for_each_record(archive, [&](std::span<const std::byte> record) {
+      objects.push_back(
+          holder::registry::template load<typename holder::type>(record));
+    });
+    benchmark::DoNotOptimize(objects.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+template <template <int> typename Shape>
+void testViewArchive(benchmark::State &state) {
+  using holder = archive_holder<Shape>;
+  using ref = erased::ref<suite::ComputeArea>;
+  const auto count = static_cast<std::size_t>(state.range(0));
+  const auto archive = make_archive<Shape>(count);
+
+  for (auto &&_ : state) {
+    std::vector<ref> objects;
+    objects.reserve(count);
+    erased::for_each_record(archive, [&](std::span<const std::byte> record) {
+      objects.push_back(holder::registry::template view<ref>(record));
+    });
+    benchmark::DoNotOptimize(objects.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+BENCHMARK(testLoadArchive<suite::Small>)->Range(1 << 8, 1 << 16);
+BENCHMARK(testLoadArchive<suite::Big>)->Range(1 << 8, 1 << 16);
+BENCHMARK(testViewArchive<suite::Small>)->Range(1 << 8, 1 << 16);
+BENCHMARK(testViewArchive<suite::Big>)->Range(1 << 8, 1 << 16);
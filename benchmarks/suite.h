@@ -0,0 +1,262 @@
+#pragma once
+
+#include "allocations.h"
+#include <any>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <erased/closed.h>
+#include <erased/erased.h>
+#include <erased/function.h>
+#include <erased/pool.h>
+#include <erased/shared.h>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <random>
+#include <variant>
+#include <vector>
+
+// Shapes and holders shared by the comparative benchmarks. Each holder wraps
+// one way of storing a shape behind a uniform make / call / copy interface.
+namespace suite {
+struct ComputeArea {
+  constexpr static double invoker(const auto &self) {
+    return self.computeArea();
+  }
+
+  // not necessary, but makes the client code easier to write
+  constexpr double computeArea(this const auto &erased) {
+    return erased.invoke(ComputeArea{});
+  }
+};
+
+template <int N> struct Small {
+  constexpr double computeArea() const { return m_size * (N + 1); }
+
+  double m_size = 1.0;
+};
+
+template <int N> struct Big {
+  constexpr double computeArea() const { return m_size * (N + 1); }
+
+  std::byte padding[120];
+  double m_size = 1.0;
+};
+
+template <typename... Ts> struct type_list {};
+
+inline constexpr std::size_t unlimited = std::numeric_limits<std::size_t>::max();
+
+// Reports the allocations and the bytes allocated by the benchmark thread per
+// iteration, since construction. The benchmark fails when it allocates more
+// than budget times per iteration.
+class allocation_meter {
+public:
+  explicit allocation_meter(std::size_t budget = unlimited) noexcept
+      : m_budget{budget} {}
+
+  void report(benchmark::State &state) const {
+    const auto counts = m_scope.elapsed();
+    const auto iterations = static_cast<std::size_t>(state.iterations());
+    state.counters["allocations"] = benchmark::Counter(
+        static_cast<double>(counts.allocations),
+        benchmark::Counter::kAvgIterations);
+    state.counters["allocated_bytes"] = benchmark::Counter(
+        static_cast<double>(counts.bytes), benchmark::Counter::kAvgIterations);
+    if (m_budget != unlimited && counts.allocations > m_budget * iterations)
+      state.SkipWithError("allocations over budget");
+  }
+
+private:
+  std::size_t m_budget;
+  allocations::scope m_scope;
+};
+
+// Allocations allowed to construct or copy a T: none for the erased types
+// that store it inline, one for the others
+template <typename Type, typename T>
+constexpr std::size_t allocation_budget() {
+  if constexpr (erased::is_erased_v<Type>)
+    return Type::template stores_inline<T> ? 0 : 1;
+  else
+    return unlimited;
+}
+
+// Megamorphic call sites pick among all of them
+template <template <int> typename Shape>
+using family = type_list<Shape<0>, Shape<1>, Shape<2>, Shape<3>, Shape<4>,
+                         Shape<5>, Shape<6>, Shape<7>>;
+
+template <typename Family> struct erased_holder {
+  using type = erased::erased<ComputeArea, erased::Copy, erased::Move>;
+
+  template <typename T> static type make() { return T{}; }
+  static double call(const type &object) { return object.computeArea(); }
+  static type copy(const type &object) { return object; }
+};
+
+template <typename Family> struct compact_holder {
+  using type = erased::erased<ComputeArea, erased::Copy, erased::Move,
+                              erased::compact<>>;
+
+  template <typename T> static type make() { return T{}; }
+  static double call(const type &object) { return object.computeArea(); }
+  static type copy(const type &object) { return object; }
+};
+
+// Heap payloads are taken from the free lists of the pool
+template <typename Family> struct pooled_holder {
+  using type = erased::erased<ComputeArea, erased::Copy, erased::Move,
+                              erased::pooled>;
+
+  template <typename T> static type make() { return T{}; }
+  static double call(const type &object) { return object.computeArea(); }
+  static type copy(const type &object) { return object; }
+};
+
+// Copies share the object instead of copying it
+template <typename Family> struct shared_holder {
+  using type = erased::shared<ComputeArea, erased::Copy>;
+
+  template <typename T> static type make() { return T{}; }
+  static double call(const type &object) { return object.computeArea(); }
+  static type copy(const type &object) { return object; }
+};
+
+template <typename Family> struct closed_holder;
+
+template <typename... Ts> struct closed_holder<type_list<Ts...>> {
+  using type = erased::closed<erased::type_list<Ts...>, ComputeArea,
+                              erased::Copy, erased::Move>;
+
+  template <typename T> static type make() { return T{}; }
+  static double call(const type &object) { return object.computeArea(); }
+  static type copy(const type &object) { return object; }
+};
+
+struct IShape {
+  virtual ~IShape() = default;
+  virtual double computeArea() const = 0;
+  virtual std::unique_ptr<IShape> clone() const = 0;
+};
+
+template <typename T> struct VirtualShape final : IShape {
+  double computeArea() const override { return m_shape.computeArea(); }
+
+  std::unique_ptr<IShape> clone() const override {
+    return std::make_unique<VirtualShape>(*this);
+  }
+
+  T m_shape;
+};
+
+template <typename Family> struct virtual_holder {
+  using type = std::unique_ptr<IShape>;
+
+  template <typename T> static type make() {
+    return std::make_unique<VirtualShape<T>>();
+  }
+  static double call(const type &object) { return object->computeArea(); }
+  static type copy(const type &object) { return object->clone(); }
+};
+
+template <typename Family> struct function_holder {
+  using type = std::function<double()>;
+
+  template <typename T> static type make() {
+    return [shape = T{}] { return shape.computeArea(); };
+  }
+  static double call(const type &object) { return object(); }
+  static type copy(const type &object) { return object; }
+};
+
+template <typename Family> struct erased_function_holder {
+  using type = erased::function<double() const>;
+
+  template <typename T> static type make() {
+    return [shape = T{}] { return shape.computeArea(); };
+  }
+  static double call(const type &object) { return object(); }
+  static type copy(const type &object) { return object; }
+};
+
+template <typename Family> struct erased_move_only_function_holder {
+  using type = erased::move_only_function<double() const>;
+
+  template <typename T> static type make() {
+    return [shape = T{}] { return shape.computeArea(); };
+  }
+  static double call(const type &object) { return object(); }
+};
+
+#ifdef __cpp_lib_move_only_function
+template <typename Family> struct move_only_function_holder {
+  using type = std::move_only_function<double() const>;
+
+  template <typename T> static type make() {
+    return [shape = T{}] { return shape.computeArea(); };
+  }
+  static double call(const type &object) { return object(); }
+};
+#endif
+
+// std::any has no behavior, the call site tries every type of the family
+template <typename Family> struct any_holder;
+
+template <typename... Ts> struct any_holder<type_list<Ts...>> {
+  using type = std::any;
+
+  template <typename T> static type make() { return T{}; }
+
+  static double call(const type &object) {
+    double result = 0.0;
+    (void)(try_call<Ts>(object, result) || ...);
+    return result;
+  }
+
+  static type copy(const type &object) { return object; }
+
+private:
+  template <typename T>
+  static bool try_call(const type &object, double &result) {
+    if (auto *shape = std::any_cast<T>(&object)) {
+      result = shape->computeArea();
+      return true;
+    }
+    return false;
+  }
+};
+
+template <typename Family> struct variant_holder;
+
+template <typename... Ts> struct variant_holder<type_list<Ts...>> {
+  using type = std::variant<Ts...>;
+
+  template <typename T> static type make() { return T{}; }
+
+  static double call(const type &object) {
+    return std::visit([](const auto &shape) { return shape.computeArea(); },
+                      object);
+  }
+
+  static type copy(const type &object) { return object; }
+};
+
+// count objects whose types are drawn at random among the first kinds types
+// of the family, with a fixed seed so that runs are comparable.
+template <typename Holder, typename... Ts>
+std::vector<typename Holder::type>
+make_objects(std::size_t count, std::size_t kinds, type_list<Ts...>) {
+  using factory = typename Holder::type (*)();
+  constexpr factory factories[] = {&Holder::template make<Ts>...};
+
+  std::mt19937 random{42};
+  std::uniform_int_distribution<std::size_t> pick{0, kinds - 1};
+
+  std::vector<typename Holder::type> objects;
+  objects.reserve(count);
+  for (std::size_t i = 0; i < count; ++i)
+    objects.push_back(factories[pick(random)]());
+  return objects;
+}
+} // namespace suite
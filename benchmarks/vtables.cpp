@@ -0,0 +1,65 @@
+#include "suite.h"
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <erased/erased.h>
+#include <utility>
+
+// Wide interfaces of 16 behaviors, of which the first and the last are
+// called. Objects are drawn among 32 types, so that 32 vtables compete with
+// the objects for the cache.
+namespace {
+template <int I> struct Entry {
+  constexpr static double invoker(const auto &self) {
+    return self.value() * (I + 1);
+  }
+};
+
+template <std::size_t N> struct Shape {
+  constexpr double value() const { return m_value + N; }
+
+  double m_value = 1.0;
+};
+
+template <typename Sequence> struct wide_interface;
+
+template <std::size_t... Is>
+struct wide_interface<std::index_sequence<Is...>> {
+  // The two hot entries are at both ends of the vtable
+  using all_hot = erased::erased<Entry<0>, Entry<Is + 2>..., Entry<1>,
+                                 erased::Copy, erased::Move>;
+  // The hot entries share the first cache line of the vtable
+  using split = erased::erased<Entry<0>, erased::cold<Entry<Is + 2>>...,
+                               Entry<1>, erased::Copy, erased::Move>;
+};
+
+using interfaces = wide_interface<std::make_index_sequence<14>>;
+
+template <std::size_t... Is>
+suite::type_list<Shape<Is>...> make_shapes(std::index_sequence<Is...>);
+
+using shapes = decltype(make_shapes(std::make_index_sequence<32>{}));
+
+template <typename Erased> struct wide_holder {
+  using type = Erased;
+
+  template <typename T> static type make() { return T{}; }
+};
+} // namespace
+
+template <typename Erased> void testWideInterface(benchmark::State &state) {
+  const auto count = static_cast<std::size_t>(state.range(0));
+  auto objects =
+      suite::make_objects<wide_holder<Erased>>(count, 32, shapes{});
+
+  for (auto &&_ : state) {
+    double sum = 0.0;
+    for (const auto &object : objects)
+      sum += object.invoke(Entry<0>{}) + object.invoke(Entry<1>{});
+    benchmark::DoNotOptimize(sum);
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+BENCHMARK(testWideInterface<interfaces::all_hot>)->Range(1 << 8, 1 << 20);
+BENCHMARK(testWideInterface<interfaces::split>)->Range(1 << 8, 1 << 20);
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "erased.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <typeinfo>
+#include <utility>
+
+#define fwd(x) static_cast<decltype(x) &&>(x)
+
+namespace erased {
+namespace details {
+// Epoch based reclamation shared by every atomic_erased. Readers publish the
+// epoch they entered in, and an object retired at epoch E is deleted once no
+// reader that entered before E is still reading.
+class epoch_domain {
+public:
+  struct slot {
+    std::atomic<std::uint64_t> m_epoch{0};
+    std::atomic<bool> m_used{true};
+    slot *m_next = nullptr;
+  };
+
+  static epoch_domain &instance() noexcept {
+    static epoch_domain domain;
+    return domain;
+  }
+
+  // Slots of finished threads are reused, they are never deleted
+  slot *acquire_slot() {
+    for (slot *s = m_slots.load(std::memory_order_acquire); s; s = s->m_next) {
+      bool expected = false;
+      if (s->m_used.compare_exchange_strong(expected, true,
+                                            std::memory_order_acquire))
+        return s;
+    }
+    auto *s = new slot;
+    s->m_next = m_slots.load(std::memory_order_relaxed);
+    while (!m_slots.compare_exchange_weak(s->m_next, s,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+    }
+    return s;
+  }
+
+  void release_slot(slot *s) noexcept {
+    s->m_used.store(false, std::memory_order_release);
+  }
+
+  std::uint64_t current() const noexcept {
+    return m_epoch.load(std::memory_order_seq_cst);
+  }
+
+  // Starts a new epoch and returns it
+  std::uint64_t advance() noexcept {
+    return m_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+  }
+
+  // No reader that entered before epoch is still reading
+  bool quiescent(std::uint64_t epoch) const noexcept {
+    for (slot *s = m_slots.load(std::memory_order_acquire); s; s = s->m_next) {
+      const auto entered = s->m_epoch.load(std::memory_order_seq_cst);
+      if (entered != 0 && entered < epoch)
+        return false;
+    }
+    return true;
+  }
+
+private:
+  std::atomic<std::uint64_t> m_epoch{1};
+  std::atomic<slot *> m_slots{nullptr};
+};
+
+// Read side critical section of the current thread. Nested sections, such as
+// a behavior reading another atomic_erased, keep the epoch of the outermost.
+// The first section of a thread may throw std::bad_alloc, when no slot of a
+// finished thread is free to reuse.
+class epoch_guard {
+  struct reader {
+    reader() : m_slot{epoch_domain::instance().acquire_slot()} {}
+    ~reader() { epoch_domain::instance().release_slot(m_slot); }
+
+    epoch_domain::slot *m_slot;
+    unsigned m_depth = 0;
+  };
+
+  static reader &local() {
+    thread_local reader reader;
+    return reader;
+  }
+
+public:
+  epoch_guard() : m_reader{local()} {
+    if (m_reader.m_depth++ == 0)
+      m_reader.m_slot->m_epoch.store(epoch_domain::instance().current(),
+                                     std::memory_order_seq_cst);
+  }
+
+  ~epoch_guard() {
+    if (--m_reader.m_depth == 0)
+      m_reader.m_slot->m_epoch.store(0, std::memory_order_release);
+  }
+
+  epoch_guard(const epoch_guard &) = delete;
+  epoch_guard &operator=(const epoch_guard &) = delete;
+
+private:
+  reader &m_reader;
+};
+} // namespace details
+
+template <typename... Methods> class atomic_erased;
+
+template <typename T> struct is_atomic_erased : std::false_type {};
+
+template <typename... Methods>
+struct is_atomic_erased<atomic_erased<Methods...>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_atomic_erased_v = is_atomic_erased<T>::value;
+
+// Erased object that can be replaced while other threads call it, in the
+// manner of RCU. Readers call const behaviors without waiting, writers
+// publish a new object, and the replaced one is deleted once the readers
+// that could still see it are done.
+// Behaviors returning references must not let them escape the call. The first
+// read of a thread allocates its epoch slot, and may throw std::bad_alloc.
+template <typename... Methods> class atomic_erased : public Methods... {
+public:
+  using value_type = erased<Methods...>;
+
+  template <typename T>
+  atomic_erased(std::in_place_type_t<T>, auto &&...args)
+      : m_current{new node{std::in_place_type<T>, fwd(args)...}} {}
+
+  template <typename T>
+  atomic_erased(T x)
+      : atomic_erased{std::in_place_type<T>, static_cast<T &&>(x)} {}
+
+  atomic_erased(const atomic_erased &) = delete;
+  atomic_erased &operator=(const atomic_erased &) = delete;
+
+  template <typename Method>
+  decltype(auto) invoke(Method method, auto &&...xs) const {
+    details::epoch_guard guard;
+    const auto *current = m_current.load(std::memory_order_seq_cst);
+    return current->m_value.invoke(method, fwd(xs)...);
+  }
+
+  // Publishes a new object, the previous one is deleted later
+  template <typename T> void emplace(auto &&...args) {
+    auto *next = new node{std::in_place_type<T>, fwd(args)...};
+    std::lock_guard lock{m_writer};
+    retire(m_current.exchange(next, std::memory_order_seq_cst));
+  }
+
+  template <typename T> void store(T x) {
+    emplace<T>(static_cast<T &&>(x));
+  }
+
+  // Deletes the replaced objects that no reader can see anymore
+  void reclaim() {
+    std::lock_guard lock{m_writer};
+    reclaim_retired();
+  }
+
+  // No reader may be running
+  ~atomic_erased() {
+    delete m_current.load(std::memory_order_relaxed);
+    while (m_retired)
+      delete std::exchange(m_retired, m_retired->m_next);
+  }
+
+  template <typename T, typename... M>
+  friend bool is(const atomic_erased<M...> &object);
+
+private:
+  struct node {
+    template <typename T>
+    node(std::in_place_type_t<T>, auto &&...args)
+        : m_value{std::in_place_type<T>, fwd(args)...} {}
+
+    value_type m_value;
+    node *m_next = nullptr;
+    std::uint64_t m_epoch = 0;
+  };
+
+  void retire(node *old) {
+    old->m_epoch = details::epoch_domain::instance().advance();
+    old->m_next = m_retired;
+    m_retired = old;
+    reclaim_retired();
+  }
+
+  void reclaim_retired() {
+    const auto &domain = details::epoch_domain::instance();
+    for (node **link = &m_retired; *link;) {
+      if (domain.quiescent((*link)->m_epoch))
+        delete std::exchange(*link, (*link)->m_next);
+      else
+        link = &(*link)->m_next;
+    }
+  }
+
+  std::atomic<node *> m_current;
+  std::mutex m_writer;
+  node *m_retired = nullptr;
+};
+
+// Whether the object published when called holds a T
+template <typename T, typename... Methods>
+bool is(const atomic_erased<Methods...> &object) {
+  details::epoch_guard guard;
+  return is<T>(object.m_current.load(std::memory_order_seq_cst)->m_value);
+}
+} // namespace erased
+
+#undef fwd
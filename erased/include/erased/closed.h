@@ -0,0 +1,247 @@
+#pragma once
+
+#include "erased.h"
+#include "utils/utils.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+#define fwd(x) static_cast<decltype(x) &&>(x)
+
+namespace erased {
+using details::type_list;
+
+namespace details {
+template <typename... Ts> union closed_storage {};
+
+// Recursive union, so that the alternatives can be constructed and destroyed
+// during constant evaluation.
+template <typename T, typename... Ts> union closed_storage<T, Ts...> {
+  constexpr closed_storage() noexcept : m_empty{} {}
+
+  constexpr ~closed_storage()
+    requires(std::is_trivially_destructible_v<T> &&
+             (std::is_trivially_destructible_v<Ts> && ...))
+  = default;
+  constexpr ~closed_storage() {}
+
+  template <std::size_t I> constexpr auto &get() noexcept {
+    if constexpr (I == 0)
+      return m_first;
+    else
+      return m_rest.template get<I - 1>();
+  }
+
+  template <std::size_t I> constexpr const auto &get() const noexcept {
+    if constexpr (I == 0)
+      return m_first;
+    else
+      return m_rest.template get<I - 1>();
+  }
+
+  template <std::size_t I, typename... Args>
+  constexpr void emplace(Args &&...args) {
+    if constexpr (I == 0) {
+      std::construct_at(std::addressof(m_first),
+                        static_cast<Args &&>(args)...);
+    } else {
+      std::construct_at(std::addressof(m_rest));
+      m_rest.template emplace<I - 1>(static_cast<Args &&>(args)...);
+    }
+  }
+
+  char m_empty;
+  T m_first;
+  closed_storage<Ts...> m_rest;
+};
+
+template <std::size_t Count>
+using closed_index_t =
+    fast_conditional<(Count <= 256)>::template apply<std::uint8_t,
+                                                     std::uint16_t>;
+} // namespace details
+
+template <typename Types, typename... Methods> class closed;
+
+template <typename T> struct is_closed : std::false_type {};
+
+template <typename... Ts, typename... Methods>
+struct is_closed<closed<type_list<Ts...>, Methods...>> : std::true_type {};
+
+template <typename T> constexpr bool is_closed_v = is_closed<T>::value;
+
+template <typename T>
+concept closed_concept = is_closed_v<std::decay_t<T>>;
+
+// Erased type whose concrete type is one of Ts. It stores a small index
+// instead of a vtable pointer and dispatches through a chain of comparisons
+// on it, that compilers turn into a switch or a jump table and can inline.
+// Behaviors are written as for basic_erased. Moved-from objects hold a
+// moved-from value, as std::variant does.
+template <typename... Ts, typename... Methods>
+class closed<type_list<Ts...>, Methods...> : public Methods... {
+  using index_type = details::closed_index_t<sizeof...(Ts)>;
+
+  template <typename T>
+  static constexpr std::size_t index_of =
+      details::index_in_list<T, Ts...>();
+
+public:
+  static constexpr bool copyable = details::contains<Copy, Methods...>();
+  static constexpr bool movable = details::contains<Move, Methods...>();
+
+  template <typename T>
+  static constexpr bool alternative = details::contains<T, Ts...>();
+
+  // The moves are noexcept, and the copy assignment relies on them
+  static_assert(!(copyable || movable) ||
+                    (std::is_nothrow_move_constructible_v<Ts> && ...),
+                "the types of a movable closed set must move without throwing");
+
+  template <typename T>
+  constexpr closed(std::in_place_type_t<T>, auto &&...args) noexcept
+      : m_index{static_cast<index_type>(index_of<T>)} {
+    static_assert(details::contains<T, Ts...>(),
+                  "T is not one of the types of the closed set");
+    m_storage.template emplace<index_of<T>>(fwd(args)...);
+  }
+
+  template <typename T>
+    requires alternative<T>
+  constexpr closed(T x) noexcept
+      : closed{std::in_place_type<T>, static_cast<T &&>(x)} {}
+
+  template <typename Method>
+  constexpr decltype(auto) invoke(Method, auto &&...xs) const {
+    return visit(*this, [&](const auto &object) -> decltype(auto) {
+      return Method::invoker(object, fwd(xs)...);
+    });
+  }
+
+  template <typename Method>
+  constexpr decltype(auto) invoke(Method, auto &&...xs) {
+    return visit(*this, [&](auto &object) -> decltype(auto) {
+      return Method::invoker(object, fwd(xs)...);
+    });
+  }
+
+  constexpr closed(closed &&other) noexcept
+    requires movable
+  {
+    construct_from(other);
+  }
+
+  constexpr closed &operator=(closed &&other) noexcept
+    requires movable
+  {
+    if (this != &other) {
+      destroy();
+      construct_from(other);
+    }
+    return *this;
+  }
+
+  constexpr closed(const closed &other)
+    requires copyable
+  {
+    construct_from(other);
+  }
+
+  // The alternative of other is copied before this one is destroyed, so that
+  // a throwing copy leaves this object as it was. Moves do not throw.
+  constexpr closed &operator=(const closed &other)
+    requires copyable
+  {
+    if (this != &other) {
+      visit(other, [&](const auto &object) {
+        auto copy = object;
+        destroy();
+        construct_alternative(std::move(copy));
+      });
+    }
+    return *this;
+  }
+
+  constexpr std::size_t index() const noexcept { return m_index; }
+
+  constexpr ~closed() { destroy(); }
+
+  template <typename T, closed_concept Closed>
+    requires std::remove_const_t<Closed>::template alternative<T>
+  friend constexpr auto *any_cast(Closed *object);
+
+private:
+  template <std::size_t I = 0, typename Self, typename F>
+  static constexpr decltype(auto) visit(Self &self, F &&f) {
+    if constexpr (I + 1 == sizeof...(Ts)) {
+      return f(self.m_storage.template get<I>());
+    } else {
+      if (self.m_index == I)
+        return f(self.m_storage.template get<I>());
+      return visit<I + 1>(self, f);
+    }
+  }
+
+  // Copies the alternative of a const other, moves it otherwise
+  template <typename Other> constexpr void construct_from(Other &other) {
+    visit(other, [&](auto &object) {
+      if constexpr (std::is_const_v<Other>)
+        construct_alternative(object);
+      else
+        construct_alternative(std::move(object));
+    });
+  }
+
+  // The index is only set once the alternative is constructed
+  template <typename T> constexpr void construct_alternative(T &&object) {
+    using type = std::remove_cvref_t<T>;
+    m_storage.template emplace<index_of<type>>(static_cast<T &&>(object));
+    m_index = static_cast<index_type>(index_of<type>);
+  }
+
+  template <typename T> constexpr T *get_if() noexcept {
+    if (m_index == index_of<T>)
+      return std::addressof(m_storage.template get<index_of<T>>());
+    return nullptr;
+  }
+
+  template <typename T> constexpr const T *get_if() const noexcept {
+    return const_cast<closed &>(*this).template get_if<T>();
+  }
+
+  constexpr void destroy() noexcept {
+    visit(*this,
+          [](auto &object) { std::destroy_at(std::addressof(object)); });
+  }
+
+  details::closed_storage<Ts...> m_storage;
+  index_type m_index = 0;
+};
+
+// The type must be one of the closed set, as for the functions below
+template <typename T, typename... Ts, typename... Methods>
+  requires(details::contains<T, Ts...>())
+constexpr bool is(const closed<type_list<Ts...>, Methods...> &object) {
+  return object.index() ==
+         static_cast<std::size_t>(details::index_in_list<T, Ts...>());
+}
+
+template <typename T, closed_concept Closed>
+  requires std::remove_const_t<Closed>::template alternative<T>
+constexpr auto *any_cast(Closed *object) {
+  return object->template get_if<T>();
+}
+
+template <typename T, closed_concept Closed>
+  requires std::remove_cvref_t<Closed>::template alternative<T>
+constexpr auto &&any_cast(Closed &&object) {
+  if (auto *ptr = any_cast<T>(std::addressof(object)))
+    return std::forward_like<Closed>(*ptr);
+  throw std::bad_cast();
+}
+} // namespace erased
+
+#undef fwd
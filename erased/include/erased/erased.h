@@ -1,7 +1,13 @@
 #pragma once
 
+#include "policies.h"
 #include "utils/utils.h"
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <new>
 #include <typeinfo>
 #include <utility>
@@ -10,29 +16,67 @@
 
 namespace erased {
 
+// Copy and Move construct the object in an empty storage, or assign it to
+// the object of the same type that a soo holds
 struct Copy {
-  template <typename T>
-  static constexpr void *invoker(const T &object, void *sooPtr,
-                                 std::size_t sooSize) {
-    if (sizeof object > sooSize || std::is_constant_evaluated())
-      return new T{object};
-    else {
-      return new (sooPtr) T{object};
+  template <typename Soo> struct for_storage {
+    template <typename T>
+    static constexpr void invoker(const T &object, Soo *soo) {
+      if constexpr (requires { soo->template assign<T>(object); }) {
+        if (soo->has_value())
+          return soo->template assign<T>(object);
+      }
+      soo->template construct<T>(object);
     }
-  }
+  };
 };
 
 struct Move {
-  template <typename T>
-  static constexpr void *invoker(T &object, void *sooPtr, std::size_t sooSize) {
-    if (sizeof object > sooSize || std::is_constant_evaluated())
-      return new T{std::move(object)};
-    else {
-      return new (sooPtr) T{std::move(object)};
+  template <typename Soo> struct for_storage {
+    template <typename T> static constexpr void invoker(T &object, Soo *soo) {
+      if constexpr (requires { soo->template assign<T>(std::move(object)); }) {
+        if (soo->has_value())
+          return soo->template assign<T>(std::move(object));
+      }
+      soo->template construct<T>(std::move(object));
     }
+  };
+};
+
+// Hash of the object, std::hash of its concrete type, given by
+// basic_erased::hash and std::hash. The storage is needed to read the hash
+// cached by the cached_hash policy.
+struct Hash {
+  template <typename Soo> struct for_storage {
+    template <typename T>
+    static constexpr std::size_t invoker(const T &object, const Soo *soo) {
+      if constexpr (Soo::template caches_hash<T>) {
+        if (!std::is_constant_evaluated() && soo->is_inline())
+          return soo->cached_hash();
+      }
+      return std::hash<T>{}(object);
+    }
+  };
+};
+
+// Equality of two objects of the same concrete type, called by the operator==
+// of basic_erased once the vtables compared equal
+struct EqualTo {
+  template <typename T>
+  static constexpr bool invoker(const T &object, const void *other) {
+    return object == *static_cast<const T *>(other);
   }
 };
 
+// Types for which moving to a new address and ending the lifetime of the
+// source is equivalent to copying the bytes. Specialize it to opt in types
+// that are not trivially copyable but keep no pointer to themselves.
+template <typename T>
+struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+
+template <typename T>
+constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
 namespace details {
 template <typename Soo> struct Destructor {
   template <typename T> static constexpr void invoker(T &, Soo *soo) {
@@ -40,57 +84,453 @@ template <typename Soo> struct Destructor {
   }
 };
 
+// The built-in entries are cold, except the type properties read by moves
+struct builtin_cold_traits {
+  static constexpr bool is_marked = false;
+  static constexpr bool is_cold = true;
+};
+
+template <typename Soo>
+struct cold_traits<Copy::for_storage<Soo>> : builtin_cold_traits {
+  using type = Copy::for_storage<Soo>;
+};
+
+template <typename Soo>
+struct cold_traits<Move::for_storage<Soo>> : builtin_cold_traits {
+  using type = Move::for_storage<Soo>;
+};
+
+template <typename Soo>
+struct cold_traits<Destructor<Soo>> : builtin_cold_traits {
+  using type = Destructor<Soo>;
+};
+
+// Behaviors that need to know the storage, such as Copy and Move, provide a
+// nested for_storage template that is used in the vtable instead.
+template <typename Method, typename Soo> struct bind_storage {
+  using type = Method;
+};
+
+template <typename Method, typename Soo>
+  requires requires { typename Method::template for_storage<Soo>; }
+struct bind_storage<Method, Soo> {
+  using type = typename Method::template for_storage<Soo>;
+};
+
+template <typename Method, typename Soo>
+using bind_storage_t = typename bind_storage<Method, Soo>::type;
+
+struct type_properties {
+  std::uint32_t size;
+  std::uint16_t alignment;
+  bool trivially_relocatable;
+  bool stored_inline;
+
+  constexpr bool operator==(const type_properties &) const = default;
+};
+
+template <typename Soo> struct Properties {
+  using value_type = type_properties;
+
+  template <typename T>
+  static constexpr type_properties value{sizeof(T), alignof(T),
+                                         is_trivially_relocatable_v<T>,
+                                         Soo::template fits<T>};
+};
+
+// Vtable of the concrete type for Soo, the storage of another erased type
+template <typename Soo> struct Conversion {
+  using value_type = typename Soo::layout;
+
+  template <typename T>
+  static constexpr value_type value = value_type::template for_type<T>();
+};
+
+template <typename Soo>
+struct cold_traits<Conversion<Soo>> : builtin_cold_traits {
+  using type = Conversion<Soo>;
+};
+
+// Caches the hash of the object again, see cached_hash
+template <typename Soo> struct Rehash {
+  template <typename T>
+  static constexpr void invoker(const T &object, Soo *soo) noexcept {
+    if constexpr (Soo::template caches_hash<T>) {
+      if (!std::is_constant_evaluated())
+        soo->cache_hash(std::hash<T>{}(object));
+    }
+  }
+};
+
+// Rehashes once a behavior that may modify the object returned or threw
+template <typename Soo> struct rehash_on_exit {
+  constexpr ~rehash_on_exit() { soo.rehash(); }
+
+  Soo &soo;
+};
+
 template <int Size, typename... Methods> struct soo {
-  using vtable = details::vtable<Methods..., Destructor<soo>>;
+  using instrumentation = details::instrumentation_t<Methods...>;
+  using hash_cache = details::hash_cache_t<Methods...>;
+  using vtable = details::vtable_for_t<
+      bind_storage_t<Methods, soo>..., Destructor<soo>, Properties<soo>,
+      typename instrumentation::entry,
+      typename hash_cache::template entry<soo>>;
+  using layout = details::vtable_layout_t<vtable, Methods...>;
+  using heap = details::heap_t<Methods...>;
+  using storage = details::storage_t<Methods...>;
+  static constexpr bool compact = storage::is_compact;
+  static constexpr bool inline_only = storage::is_inline_only;
+  // The compact and inline only buffers are aligned by themselves
+  static constexpr bool aligned_buffer = compact || inline_only;
+  static constexpr std::size_t heap_size =
+      std::is_empty_v<heap> ? 0 : sizeof(heap);
+  // The compact storage keeps its heap pointer inside the buffer
+  static constexpr std::size_t pointer_size =
+      aligned_buffer ? 0 : sizeof(void *);
+  static_assert(pointer_size + sizeof(layout) + heap_size < Size,
+                "Size is too small to store the vtable");
+  static constexpr std::size_t buffer_alignment =
+      Size < storage::alignment ? Size : storage::alignment;
+  static_assert(!aligned_buffer || Size % buffer_alignment == 0,
+                "Size must be a multiple of the alignment");
+  // An aligned buffer has its size rounded down
   static constexpr auto buffer_size =
-      Size - sizeof(void *) - sizeof(const vtable *);
-  std::array<std::byte, buffer_size> m_buffer;
-  void *ptr = nullptr;
-  const vtable *vtable_ptr = nullptr;
+      (Size - pointer_size - sizeof(layout) - heap_size) /
+      (aligned_buffer ? buffer_alignment : 1) *
+      (aligned_buffer ? buffer_alignment : 1);
+  // Otherwise, the pointer to inline objects points inside the buffer
+  static constexpr bool trivially_relocatable =
+      compact && is_trivially_relocatable_v<heap>;
+  typename storage::template apply<buffer_size, buffer_alignment> m_storage;
+  layout table{};
+  ERASED_NO_UNIQUE_ADDRESS heap m_heap{};
+
+  constexpr soo() = default;
+  constexpr explicit soo(const heap &heap) noexcept : m_heap{heap} {}
+
+  template <typename T>
+  static constexpr bool fits =
+      sizeof(T) <= buffer_size && alignof(T) <= buffer_alignment &&
+      (!compact || is_trivially_relocatable_v<T>);
+
+  // The hash is cached in the last bytes of the buffer, which the inline
+  // object must leave free
+  template <typename T>
+  static constexpr bool caches_hash =
+      hash_cache::enabled && index_in_list<Hash, Methods...>() >= 0 &&
+      fits<T> && sizeof(T) + sizeof(std::size_t) <= buffer_size;
+
+  // Whether invoking Method may modify the object and stale its cached hash
+  template <typename Method> static consteval bool rehashes_after() {
+    if constexpr (hash_cache::enabled &&
+                  index_in_list<Method,
+                                typename cold_traits<Methods>::type...>() >= 0)
+      return !method_to_trait_t<bind_storage_t<Method, soo>>::is_const;
+    else
+      return false;
+  }
 
   template <typename T, typename... Args>
   constexpr T *construct(Args &&...args) {
     static_assert(sizeof(soo) == Size);
-    if constexpr (sizeof(T) <= buffer_size) {
+    T *ptr;
+    if constexpr (fits<T>) {
       if (std::is_constant_evaluated()) {
         ptr = new T{fwd(args)...};
+        m_storage.set_heap(ptr);
       } else {
-        ptr = new (m_buffer.data()) T{fwd(args)...};
+        ptr = new (m_storage.inline_data()) T{fwd(args)...};
+      }
+    } else {
+      if constexpr (inline_only)
+        static_assert(check_fits_inline<T, sizeof(T), alignof(T), buffer_size,
+                                        buffer_alignment>::value);
+      ptr = m_heap.template create<T>(fwd(args)...);
+      m_storage.set_heap(ptr);
+    }
+    table = layout::template for_type<T>();
+    if constexpr (caches_hash<T>) {
+      if (!std::is_constant_evaluated())
+        cache_hash(std::hash<T>{}(*ptr));
+    }
+    instrumentation::template on_construct<T>(is_inline());
+    return ptr;
+  }
+
+  // Assigns value to the T held, or, when T is not assignable, as lambdas
+  // with captures, constructs a T in its place
+  template <typename T, typename Value> constexpr void assign(Value &&value) {
+    T *ptr = get<T>();
+    if constexpr (std::is_assignable_v<T &, Value &&>) {
+      *ptr = fwd(value);
+      if constexpr (caches_hash<T>) {
+        if (!std::is_constant_evaluated())
+          cache_hash(std::hash<T>{}(*ptr));
+      }
+    } else if constexpr (!fits<T> &&
+                         std::is_nothrow_constructible_v<T, Value &&>) {
+      reconstruct<T>(fwd(value));
+    } else {
+      instrumentation::template on_invoke<Destructor<soo>>(table);
+      destroy<T>();
+      reset();
+      construct<T>(fwd(value));
+    }
+  }
+
+  // Constructs a T in place of the T held on the heap, in the same block. The
+  // instrumentation sees a destruction and a construction.
+  template <typename T, typename... Args>
+  constexpr T *reconstruct(Args &&...args) noexcept {
+    static_assert(!fits<T> && std::is_nothrow_constructible_v<T, Args &&...>);
+    T *ptr = get<T>();
+    instrumentation::template on_invoke<Destructor<soo>>(table);
+    std::destroy_at(ptr);
+    std::construct_at(ptr, fwd(args)...);
+    instrumentation::template on_construct<T>(false);
+    return ptr;
+  }
+
+  // See basic_erased(constant_t<V>)
+  template <typename T> constexpr void refer(const T *constant) noexcept {
+    m_storage.set_constant(constant);
+    table = layout::template for_type<T>();
+  }
+
+  constexpr bool has_value() const noexcept { return !table.empty(); }
+
+  // Whether other holds an object of the same type, that the assignments
+  // assign to instead of destroying it. Constants are never assigned to.
+  constexpr bool holds_same_type(const soo &other) const noexcept {
+    return has_value() && table == other.table && !is_constant();
+  }
+
+  // Whether the object, if any, is taken without moving it
+  constexpr bool is_adoptable() const noexcept {
+    return !has_value() || is_constant() || !is_inline();
+  }
+
+  // Whether take adopts the object of other instead of moving it. Constants
+  // are adopted whatever the heaps, they are never moved from.
+  constexpr bool adopts(const soo &other) const noexcept {
+    return other.is_constant() ||
+           (!other.is_inline() && m_heap.is_equal(other.m_heap));
+  }
+
+  constexpr type_properties properties() const noexcept {
+    return table->template get<Properties<soo>>();
+  }
+
+  // Only the compact storage needs to look at the vtable
+  constexpr bool stored_inline() const noexcept {
+    if constexpr (compact)
+      return properties().stored_inline;
+    else
+      return false;
+  }
+
+  constexpr void *data() noexcept { return m_storage.data(stored_inline()); }
+
+  constexpr const void *data() const noexcept {
+    return m_storage.data(stored_inline());
+  }
+
+  constexpr bool is_inline() const noexcept {
+    return m_storage.is_inline(stored_inline());
+  }
+
+  // Only the pointer storage refers to constants
+  constexpr bool is_constant() const noexcept {
+    if constexpr (aligned_buffer)
+      return false;
+    else
+      return m_storage.is_constant();
+  }
+
+  constexpr void reset() noexcept {
+    m_storage.reset();
+    table = {};
+  }
+
+  constexpr std::size_t cached_hash() const noexcept {
+    std::size_t hash;
+    std::memcpy(&hash, m_storage.m_buffer.data() + buffer_size - sizeof(hash),
+                sizeof(hash));
+    return hash;
+  }
+
+  constexpr void cache_hash(std::size_t hash) noexcept {
+    std::memcpy(m_storage.m_buffer.data() + buffer_size - sizeof(hash), &hash,
+                sizeof(hash));
+  }
+
+  constexpr void rehash() noexcept {
+    table->template get<Rehash<soo>>()(data(), this);
+  }
+
+  // Moves the object of other into this empty storage and leaves other empty.
+  // Heap objects and constants are adopted and trivially relocatable inline
+  // objects are copied bytewise, none goes through the vtable.
+  constexpr void take(soo &other) noexcept {
+    if (!other.has_value())
+      return;
+    instrumentation::on_move(other.table);
+    if constexpr (!aligned_buffer) {
+      if (other.is_constant()) {
+        m_storage.set_constant(other.data());
+        table = other.table;
+        other.reset();
+        return;
       }
+    }
+    if (!other.is_inline() && m_heap.is_equal(other.m_heap)) {
+      m_storage.set_heap(other.data());
+      table = other.table;
+    } else if (other.is_inline() && other.properties().trivially_relocatable) {
+      m_storage.relocate(other.m_storage);
+      table = other.table;
     } else {
-      ptr = new T{fwd(args)...};
+      other.table->template get<Move::for_storage<soo>>()(other.data(), this);
+      other.table->template get<Destructor<soo>>()(other.data(), &other);
     }
-    vtable_ptr = vtable::template construct_for<T>();
-    return static_cast<T *>(ptr);
+    other.reset();
+  }
+
+  // Exchanges the objects of this storage and of other. Unless both are
+  // inline, the one taken first is adopted, so that only the other moves.
+  constexpr void swap(soo &other) noexcept {
+    soo &first = is_adoptable() ? *this : other;
+    soo &second = is_adoptable() ? other : *this;
+    soo tmp{first.m_heap};
+    tmp.take(first);
+    first.take(second);
+    second.take(tmp);
+  }
+
+  // Moves the object of other, the storage of another erased type, into this
+  // empty storage and leaves other empty. The object is adopted when both
+  // store it on the same heap, and moved otherwise.
+  template <typename Other>
+  constexpr void take_converted(Other &other) noexcept {
+    if (!other.has_value())
+      return;
+    Other::instrumentation::on_move(other.table);
+    const layout converted = other.table->template get<Conversion<soo>>();
+    if constexpr (std::is_same_v<heap, typename Other::heap>) {
+      if (!other.properties().stored_inline &&
+          !converted->template get<Properties<soo>>().stored_inline &&
+          m_heap.is_equal(other.m_heap)) {
+        m_storage.set_heap(other.data());
+        table = converted;
+        other.reset();
+        return;
+      }
+    }
+    converted->template get<Move::for_storage<soo>>()(other.data(), this);
+    other.table->template get<Destructor<Other>>()(other.data(), &other);
+    other.reset();
+  }
+
+  template <typename Other>
+  constexpr void copy_converted(const Other &other) {
+    if (!other.has_value())
+      return;
+    Other::instrumentation::template on_invoke<Copy::for_storage<Other>>(
+        other.table);
+    const layout converted = other.table->template get<Conversion<soo>>();
+    converted->template get<Copy::for_storage<soo>>()(other.data(), this);
   }
 
   template <typename T> constexpr T *get() noexcept {
-    return static_cast<T *>(ptr);
+    return static_cast<T *>(data());
   }
 
   template <typename T> constexpr const T *get() const noexcept {
-    return static_cast<const T *>(ptr);
+    return static_cast<const T *>(data());
   }
 
   template <typename T> constexpr void destroy() noexcept {
     T *ptr = get<T>();
-    if constexpr (sizeof(T) <= buffer_size) {
+    if constexpr (fits<T>) {
       if (std::is_constant_evaluated()) {
         delete ptr;
       } else {
         std::destroy_at(ptr);
       }
     } else {
-      delete ptr;
+      m_heap.dispose(ptr);
     }
   }
 };
 
+// basic_erased is aligned on its size, unless its buffer is aligned by itself
+template <int Size, typename... Methods>
+constexpr std::size_t erased_alignment =
+    soo<Size, Methods...>::aligned_buffer ? alignof(soo<Size, Methods...>)
+                                          : Size;
+
 template <typename T, typename... List> constexpr bool contains() {
   return (std::is_same_v<T, List> || ...);
 }
+
+// Whether the vtable of Source gives the vtable of the concrete type for Soo
+template <typename Soo, typename Source> constexpr bool converts_to_soo = false;
+
+template <typename Soo, int Size, typename... Methods>
+constexpr bool converts_to_soo<Soo, soo<Size, Methods...>> =
+    contains<Conversion<Soo>,
+             bind_storage_t<Methods, soo<Size, Methods...>>...>();
+
+template <typename Method> constexpr bool is_conversion = false;
+
+template <typename Soo> constexpr bool is_conversion<Conversion<Soo>> = true;
+
+// Whether Method takes the object by const reference, so that it may be
+// called on a constant, or is a data behavior giving const access to it.
+// Storage behaviors, as Copy and Move, handle constants themselves.
+template <typename Method, typename Soo> consteval bool keeps_constants() {
+  using behavior = typename cold_traits<Method>::type;
+  if constexpr (policy<Method> ||
+                !std::is_same_v<bind_storage_t<behavior, Soo>, behavior>)
+    return true;
+  else
+    return method_to_trait_t<behavior>::is_const;
+}
+} // namespace details
+
+// Behavior letting an erased object convert to Target, a basic_erased with
+// other behaviors or another Size, without wrapping it. Its vtable stores the
+// vtable of Target for the concrete type.
+template <typename Target> struct converts_to {
+  template <typename Soo>
+  using for_storage = details::Conversion<typename Target::soo>;
+};
+
+// Caches the hash of the objects stored inline in the last bytes of the
+// buffer, when they leave enough of them, so that Hash does not hash them
+// again. It is computed on construction and after the behaviors taking the
+// object by non-const reference: an object modified through any_cast keeps
+// its former hash.
+struct cached_hash : details::policy_tag {
+  using kind = details::hash_cache_kind;
+  static constexpr bool enabled = true;
+
+  template <typename Soo> using entry = details::Rehash<Soo>;
+};
+
+// Tag constructing a basic_erased that refers to V instead of storing a copy
+template <auto V> struct constant_t {
+  explicit constant_t() = default;
+};
+
+namespace details {
+// Scalar template parameters are not objects, so V is copied to a variable
+template <auto V> inline constexpr auto constant_object = V;
 } // namespace details
 
+template <auto V> inline constexpr constant_t<V> constant{};
+
 template <int Size, typename... Methods> struct basic_erased;
 
 template <typename T> struct is_erased : std::false_type {};
@@ -103,12 +543,47 @@ template <typename T> constexpr bool is_erased_v = is_erased<T>::value;
 template <typename T>
 concept erased_concept = is_erased_v<std::decay_t<T>>;
 
+// How a basic_erased is laid out in memory
+struct layout_report {
+  std::size_t size;
+  std::size_t alignment;
+  std::size_t buffer_size;
+  std::size_t buffer_alignment;
+  std::size_t vtable_entries;
+  bool inline_vtable;
+  bool compact;
+  bool inline_only;
+  bool trivially_relocatable;
+};
+
 template <int Size, typename... Methods>
-struct alignas(Size) basic_erased : public Methods... {
+struct alignas(details::erased_alignment<Size, Methods...>) basic_erased
+    : public Methods... {
   using soo = details::soo<Size, Methods...>;
 
   static constexpr bool copyable = details::contains<Copy, Methods...>();
   static constexpr bool movable = details::contains<Move, Methods...>();
+  static constexpr bool hashable = details::contains<Hash, Methods...>();
+  static constexpr bool equality_comparable =
+      details::contains<EqualTo, Methods...>();
+
+  template <typename T>
+  static constexpr bool stores_inline = soo::template fits<T>;
+
+  static constexpr layout_report report() noexcept {
+    return {sizeof(basic_erased),
+            alignof(basic_erased),
+            soo::buffer_size,
+            soo::buffer_alignment,
+            soo::vtable::size,
+            std::is_same_v<typename soo::layout,
+                           details::vtable_value<typename soo::vtable>>,
+            soo::compact,
+            soo::inline_only,
+            soo::trivially_relocatable};
+  }
+
+  using allocator_type = typename soo::heap::allocator_type;
 
   template <typename T>
   constexpr basic_erased(std::in_place_type_t<T>, auto &&...args) noexcept {
@@ -119,55 +594,184 @@ struct alignas(Size) basic_erased : public Methods... {
   constexpr basic_erased(T x) noexcept
       : basic_erased{std::in_place_type<T>, static_cast<T &&>(x)} {}
 
+  // Refers to V, a constant of static storage: nothing is constructed nor
+  // allocated, so constinit objects and arrays of them are initialized at
+  // compile time. Moves adopt the constant, copies construct a copy of it and
+  // destruction leaves it alone. The behaviors must take the object by const
+  // reference.
+  template <auto V> constexpr basic_erased(constant_t<V>) noexcept {
+    static_assert(!soo::aligned_buffer,
+                  "Only the default storage refers to constants");
+    static_assert((details::keeps_constants<Methods, soo>() && ...),
+                  "The behaviors of constants take the object by const "
+                  "reference");
+    static_assert(
+        !(details::is_conversion<details::bind_storage_t<Methods, soo>> ||
+          ...),
+        "Constants cannot be converted to other erased types");
+    m_soo.refer(&details::constant_object<V>);
+  }
+
+  template <typename T>
+  constexpr basic_erased(std::allocator_arg_t, const allocator_type &allocator,
+                         std::in_place_type_t<T>, auto &&...args) noexcept
+      : m_soo{typename soo::heap{allocator}} {
+    m_soo.template construct<T>(fwd(args)...);
+  }
+
+  template <typename T>
+  constexpr basic_erased(std::allocator_arg_t, const allocator_type &allocator,
+                         T x) noexcept
+      : basic_erased{std::allocator_arg, allocator, std::in_place_type<T>,
+                     static_cast<T &&>(x)} {}
+
   template <typename Method>
   constexpr decltype(auto) invoke(Method, auto &&...xs) const {
-    return m_soo.vtable_ptr->template get<Method>()(
-        static_cast<const void *>(m_soo.ptr), fwd(xs)...);
+    soo::instrumentation::template on_invoke<Method>(m_soo.table);
+    return m_soo.table->template get<Method>()(m_soo.data(), fwd(xs)...);
   }
 
   template <typename Method>
   constexpr decltype(auto) invoke(Method, auto &&...xs) {
-    return m_soo.vtable_ptr->template get<Method>()(m_soo.ptr, fwd(xs)...);
+    soo::instrumentation::template on_invoke<Method>(m_soo.table);
+    if constexpr (soo::template rehashes_after<Method>()) {
+      const details::rehash_on_exit<soo> rehash{m_soo};
+      return m_soo.table->template get<Method>()(m_soo.data(), fwd(xs)...);
+    } else {
+      return m_soo.table->template get<Method>()(m_soo.data(), fwd(xs)...);
+    }
   }
 
+  // The moved-from object is left empty
   constexpr basic_erased(basic_erased &&other) noexcept
     requires movable
-  {
-    m_soo.vtable_ptr = other.m_soo.vtable_ptr;
-    m_soo.ptr = other.invoke(Move{}, static_cast<void *>(m_soo.m_buffer.data()),
-                             soo::buffer_size);
+      : m_soo{other.m_soo.m_heap} {
+    m_soo.take(other.m_soo);
+  }
+
+  constexpr basic_erased(std::allocator_arg_t, const allocator_type &allocator,
+                         basic_erased &&other) noexcept
+    requires movable
+      : m_soo{typename soo::heap{allocator}} {
+    m_soo.take(other.m_soo);
   }
 
+  // An object of the same type is move assigned to, unless the object of
+  // other is adopted, which allocates nothing either
   constexpr basic_erased &operator=(basic_erased &&other) noexcept
     requires movable
   {
-    destroy();
-    m_soo.vtable_ptr = other.m_soo.vtable_ptr;
-    m_soo.ptr = other.invoke(Move{}, static_cast<void *>(m_soo.m_buffer.data()),
-                             soo::buffer_size);
+    if (this == &other)
+      return *this;
+    if (m_soo.holds_same_type(other.m_soo) && !m_soo.adopts(other.m_soo)) {
+      soo::instrumentation::on_move(other.m_soo.table);
+      other.m_soo.table->template get<Move::for_storage<soo>>()(
+          other.m_soo.data(), &m_soo);
+      other.destroy();
+    } else {
+      destroy();
+      m_soo.take(other.m_soo);
+    }
     return *this;
   }
 
-  constexpr basic_erased(const basic_erased &other)
+  // Converts from an erased type declaring converts_to<basic_erased>. The
+  // object is adopted when both types store it on the same heap, so only
+  // objects moving between the heap and a buffer are moved.
+  template <int S, typename... M>
+    requires movable && details::converts_to_soo<soo, details::soo<S, M...>>
+  constexpr basic_erased(basic_erased<S, M...> &&other) noexcept {
+    m_soo.take_converted(other.m_soo);
+  }
+
+  template <int S, typename... M>
+    requires copyable && details::converts_to_soo<soo, details::soo<S, M...>>
+  constexpr basic_erased(const basic_erased<S, M...> &other) noexcept(
+      soo::inline_only) {
+    m_soo.copy_converted(other.m_soo);
+  }
+
+  constexpr basic_erased(const basic_erased &other) noexcept(soo::inline_only)
     requires copyable
-  {
-    m_soo.vtable_ptr = other.m_soo.vtable_ptr;
-    m_soo.ptr = other.invoke(Copy{}, static_cast<void *>(m_soo.m_buffer.data()),
-                             soo::buffer_size);
+      : m_soo{other.m_soo.m_heap.select_on_copy()} {
+    if (other.has_value())
+      other.invoke(Copy::for_storage<soo>{}, &m_soo);
   }
 
-  constexpr basic_erased &operator=(const basic_erased &other)
+  constexpr basic_erased(std::allocator_arg_t, const allocator_type &allocator,
+                         const basic_erased &other) noexcept(soo::inline_only)
+    requires copyable
+      : m_soo{typename soo::heap{allocator}} {
+    if (other.has_value())
+      other.invoke(Copy::for_storage<soo>{}, &m_soo);
+  }
+
+  // An object of the same type is copy assigned to, which keeps its heap
+  // block
+  constexpr basic_erased &
+  operator=(const basic_erased &other) noexcept(soo::inline_only)
     requires copyable
   {
-    destroy();
-    m_soo.vtable_ptr = other.m_soo.vtable_ptr;
-    m_soo.ptr = other.invoke(Copy{}, static_cast<void *>(m_soo.m_buffer.data()),
-                             soo::buffer_size);
+    if (this != &other) {
+      if (!m_soo.holds_same_type(other.m_soo))
+        destroy();
+      if (other.has_value())
+        other.invoke(Copy::for_storage<soo>{}, &m_soo);
+    }
     return *this;
   }
 
-  constexpr void destroy() {
-    invoke(details::Destructor<decltype(m_soo)>{}, &m_soo);
+  friend constexpr void swap(basic_erased &lhs, basic_erased &rhs) noexcept
+    requires movable
+  {
+    lhs.m_soo.swap(rhs.m_soo);
+  }
+
+  // Replaces the object by a T constructed from args. A T already held on the
+  // heap leaves its block to the new one, when constructing it cannot throw.
+  template <typename T, typename... Args>
+  constexpr T &emplace(Args &&...args) {
+    if constexpr (!soo::template fits<T> &&
+                  std::is_nothrow_constructible_v<T, Args &&...>) {
+      if (m_soo.table.template holds<T>() && !m_soo.is_constant())
+        return *m_soo.template reconstruct<T>(fwd(args)...);
+    }
+    destroy();
+    return *m_soo.template construct<T>(fwd(args)...);
+  }
+
+  constexpr bool has_value() const noexcept { return m_soo.has_value(); }
+
+  // std::hash of the object, or 0 when empty
+  constexpr std::size_t hash() const
+    requires hashable
+  {
+    if (!has_value())
+      return 0;
+    return invoke(Hash::for_storage<soo>{}, &m_soo);
+  }
+
+  // Objects of different types are not equal, without calling EqualTo, and
+  // empty objects are only equal to each other
+  friend constexpr bool operator==(const basic_erased &lhs,
+                                   const basic_erased &rhs)
+    requires equality_comparable
+  {
+    if (!(lhs.m_soo.table == rhs.m_soo.table))
+      return false;
+    return !lhs.has_value() || lhs.invoke(EqualTo{}, rhs.m_soo.data());
+  }
+
+  constexpr allocator_type get_allocator() const noexcept {
+    return m_soo.m_heap.get_allocator();
+  }
+
+  constexpr void destroy() noexcept {
+    if (has_value()) {
+      if (!m_soo.is_constant())
+        invoke(details::Destructor<soo>{}, &m_soo);
+      m_soo.reset();
+    }
   }
 
   constexpr ~basic_erased() { destroy(); }
@@ -181,35 +785,100 @@ struct alignas(Size) basic_erased : public Methods... {
   template <typename T, erased_concept Erased>
   friend constexpr auto &&any_cast(Erased &&object);
 
+  friend struct details::access;
+
+  template <int S, typename... M> friend struct basic_erased;
+
 private:
   soo m_soo;
 };
 
+template <int Size, typename... Methods>
+struct is_trivially_relocatable<basic_erased<Size, Methods...>>
+    : std::bool_constant<
+          basic_erased<Size, Methods...>::soo::trivially_relocatable> {};
+
 template <typename... Methods> using erased = basic_erased<32, Methods...>;
 
+// Never allocates, see inline_only
+template <int Size, std::size_t Alignment, typename... Methods>
+using inplace = basic_erased<Size, Methods..., inline_only<Alignment>>;
+
 template <typename T, int Size, typename... Methods>
 constexpr bool is(const basic_erased<Size, Methods...> &object) {
-  using soo = typename basic_erased<Size, Methods...>::soo;
-  using vtable = typename soo::vtable;
-
-  return object.m_soo.vtable_ptr == vtable::template construct_for<T>();
+  return object.m_soo.table.template holds<T>();
 }
 
+// A constant is only given through a const erased object: any_cast of a non
+// const one holding a constant returns nullptr or throws std::bad_cast
 template <typename T, erased_concept Erased>
 constexpr auto *any_cast(Erased *object) {
+  using pointer = decltype(object->m_soo.template get<T>());
+  if constexpr (!std::is_const_v<Erased>) {
+    if (object->m_soo.is_constant())
+      return pointer{nullptr};
+  }
   if (is<T>(*object))
     return object->m_soo.template get<T>();
-  return decltype(object->m_soo.template get<T>()){nullptr};
+  return pointer{nullptr};
 }
 
 template <typename T, erased_concept Erased>
 constexpr auto &&any_cast(Erased &&object) {
-  if (is<T>(object))
-    return std::forward_like<Erased>(*object.m_soo.template get<T>());
+  if (auto *ptr = any_cast<T>(std::addressof(object)))
+    return std::forward_like<Erased>(*ptr);
   throw std::bad_cast();
 }
+
+// Transparent hash of unordered containers keyed on basic_erased, which
+// hashes a key of a concrete type like an erased object holding it would
+template <typename Erased> struct erased_hash {
+  using is_transparent = void;
+
+  constexpr std::size_t operator()(const Erased &object) const {
+    return object.hash();
+  }
+
+  template <typename T>
+    requires(!erased_concept<T>)
+  constexpr std::size_t operator()(const T &object) const {
+    return std::hash<T>{}(object);
+  }
+};
+
+// Transparent equality of unordered containers keyed on basic_erased, which
+// compares a key of a concrete type without constructing an erased object
+template <typename Erased> struct erased_equal_to {
+  using is_transparent = void;
+
+  constexpr bool operator()(const Erased &lhs, const Erased &rhs) const {
+    return lhs == rhs;
+  }
+
+  template <typename T>
+    requires(!erased_concept<T>)
+  constexpr bool operator()(const Erased &lhs, const T &rhs) const {
+    const T *object = any_cast<T>(&lhs);
+    return object && *object == rhs;
+  }
+
+  template <typename T>
+    requires(!erased_concept<T>)
+  constexpr bool operator()(const T &lhs, const Erased &rhs) const {
+    return (*this)(rhs, lhs);
+  }
+};
 } // namespace erased
 
+template <int Size, typename... Methods>
+  requires erased::basic_erased<Size, Methods...>::hashable
+struct std::hash<erased::basic_erased<Size, Methods...>> {
+  constexpr std::size_t
+  operator()(const erased::basic_erased<Size, Methods...> &object) const {
+    return object.hash();
+  }
+};
+
 #undef fwd
 
 #define ERASED_HEAD(a, ...) a
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "erased.h"
+#include "policies.h"
+#include "ref.h"
+#include "utils/access.h"
+#include "utils/utils.h"
+#include <functional>
+#include <type_traits>
+
+namespace erased {
+using details::type_list;
+
+template <typename Signature> struct call;
+
+// Behavior calling the object with the arguments of Signature, that may be
+// const and noexcept qualified like the signatures of std::move_only_function.
+// It gives the erased types a matching operator().
+template <typename ReturnType, typename... Args, bool NoExcept>
+struct call<ReturnType(Args...) noexcept(NoExcept)> {
+  template <typename T>
+  static constexpr ReturnType invoker(T &self,
+                                      Args... args) noexcept(NoExcept) {
+    return std::invoke_r<ReturnType>(self, static_cast<Args &&>(args)...);
+  }
+
+  // Only non const objects can be called, as by std::move_only_function
+  template <typename Self>
+    requires(!std::is_const_v<std::remove_reference_t<Self>>)
+  constexpr ReturnType operator()(this Self &&self,
+                                  Args... args) noexcept(NoExcept) {
+    return self.invoke(call{}, static_cast<Args &&>(args)...);
+  }
+};
+
+template <typename ReturnType, typename... Args, bool NoExcept>
+struct call<ReturnType(Args...) const noexcept(NoExcept)> {
+  template <typename T>
+  static constexpr ReturnType invoker(const T &self,
+                                      Args... args) noexcept(NoExcept) {
+    return std::invoke_r<ReturnType>(self, static_cast<Args &&>(args)...);
+  }
+
+  constexpr ReturnType operator()(this const auto &self,
+                                  Args... args) noexcept(NoExcept) {
+    return self.invoke(call{}, static_cast<Args &&>(args)...);
+  }
+};
+
+template <int Size, typename Signatures, typename... Methods>
+class basic_function;
+
+// Owning callable with one operator() per signature, stored in a
+// basic_erased of Size bytes. Methods adds behaviors, such as Copy, and
+// policies.
+template <int Size, typename... Signatures, typename... Methods>
+class basic_function<Size, type_list<Signatures...>, Methods...>
+    : public basic_erased<Size, call<Signatures>..., Move, Methods...> {
+  using base = basic_erased<Size, call<Signatures>..., Move, Methods...>;
+
+public:
+  using base::base;
+  using call<Signatures>::operator()...;
+};
+
+// A basic_function is the basic_erased it derives from, for any_cast, is and
+// the refs projected on its callable
+template <int Size, typename Signatures, typename... Methods>
+struct is_erased<basic_function<Size, Signatures, Methods...>>
+    : std::true_type {};
+
+namespace details {
+template <typename Ref, typename Layout, int Size, typename... Signatures,
+          typename... Methods>
+struct projection<Ref, Layout,
+                  basic_function<Size, type_list<Signatures...>, Methods...>>
+    : projection<Ref, Layout,
+                 basic_erased<Size, call<Signatures>..., Move, Methods...>> {};
+} // namespace details
+
+template <typename... Signatures>
+using function = basic_function<32, type_list<Signatures...>, Copy>;
+
+template <typename... Signatures>
+using move_only_function = basic_function<32, type_list<Signatures...>>;
+
+// Non owning callable, that stores the function pointer next to the object
+// pointer when there are at most two signatures. Functions and function
+// pointers are referred to by the address of the function, as by
+// std::function_ref, so a function_ref built from a temporary pointer does not
+// dangle. A function_ref built from a function, or another erased object
+// with the call behaviors, refers to its callable, see project.
+template <typename... Signatures>
+class function_ref : public ref<call<Signatures>..., inline_vtable<>> {
+  using base = ref<call<Signatures>..., inline_vtable<>>;
+
+  template <typename F>
+  static constexpr bool projects =
+      details::access::projects<base, std::remove_reference_t<F>>();
+
+public:
+  template <typename F>
+    requires std::is_object_v<std::remove_reference_t<F>> &&
+             (!std::is_same_v<std::remove_cvref_t<F>, function_ref>) &&
+             (!std::is_function_v<
+                 std::remove_pointer_t<std::remove_cvref_t<F>>>) &&
+             (!projects<F>)
+  constexpr function_ref(F &&f) noexcept : base{f} {}
+
+  template <typename F>
+    requires projects<F>
+  constexpr function_ref(F &&f) noexcept : base{project<base>(f)} {}
+
+  template <typename F>
+    requires std::is_function_v<F>
+  function_ref(F *f) noexcept : base{*f} {}
+
+  using call<Signatures>::operator()...;
+};
+} // namespace erased
@@ -0,0 +1,228 @@
+#pragma once
+
+#include "erased.h"
+#include "utils/utils.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <source_location>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace erased {
+namespace details {
+template <typename T> constexpr std::string_view type_name() {
+  std::string_view name = std::source_location::current().function_name();
+  // GCC and Clang: "... [with T = Name; ...]" or "... [T = Name]"
+  if (const auto begin = name.find("T = "); begin != name.npos) {
+    name.remove_prefix(begin + 4);
+    const auto end = name.find(';');
+    return name.substr(0, end != name.npos ? end : name.rfind(']'));
+  }
+  // MSVC: "... type_name<Name>(void)"
+  const auto begin = name.find("type_name<") + 10;
+  return name.substr(begin, name.rfind(">(") - begin);
+}
+
+struct instrumented_type {
+  std::string_view name;
+};
+
+template <typename T>
+inline constexpr instrumented_type instrumented_type_v{type_name<T>()};
+
+struct instrumentation_event {
+  std::string_view name;
+};
+
+// Events are named after the behavior, except for the built-in ones
+template <typename Method> struct event_name {
+  static constexpr std::string_view value = type_name<Method>();
+};
+
+template <> struct event_name<Move> {
+  static constexpr std::string_view value = "move";
+};
+
+template <typename Soo> struct event_name<Copy::for_storage<Soo>> {
+  static constexpr std::string_view value = "copy";
+};
+
+template <typename Soo> struct event_name<Destructor<Soo>> {
+  static constexpr std::string_view value = "destroy";
+};
+
+template <typename Soo> struct event_name<Hash::for_storage<Soo>> {
+  static constexpr std::string_view value = "hash";
+};
+
+template <typename Method>
+inline constexpr instrumentation_event event_v{event_name<Method>::value};
+
+inline constexpr instrumentation_event construct_inline_event{
+    "construct inline"};
+inline constexpr instrumentation_event construct_heap_event{"construct heap"};
+
+// Data behavior giving the concrete type of an instrumented object
+struct TypeRecord {
+  using value_type = const instrumented_type *;
+
+  template <typename T>
+  static constexpr value_type value = &instrumented_type_v<T>;
+};
+
+using instrumentation_key =
+    std::pair<const instrumented_type *, const instrumentation_event *>;
+
+struct instrumentation_key_hash {
+  std::size_t operator()(const instrumentation_key &key) const noexcept {
+    const std::hash<const void *> hash;
+    return hash(key.first) * 31 + hash(key.second);
+  }
+};
+
+// Counters are owned by the thread that increments them, so that counting is
+// a relaxed load and store. Other threads only read them, when aggregating.
+class instrumentation_registry {
+  struct counters {
+    counters() { instance().attach(this); }
+    ~counters() { instance().detach(this); }
+
+    // Only inserts are synchronized, lookups come from the owning thread
+    std::mutex m_mutex;
+    std::unordered_map<instrumentation_key, std::atomic<std::uint64_t>,
+                       instrumentation_key_hash>
+        m_counts;
+  };
+
+public:
+  using totals = std::unordered_map<instrumentation_key, std::uint64_t,
+                                    instrumentation_key_hash>;
+
+  static instrumentation_registry &instance() {
+    static instrumentation_registry registry;
+    return registry;
+  }
+
+  // Called by noexcept moves and destructors: an event whose counter cannot
+  // be allocated is not counted
+  static void record(const instrumented_type *type,
+                     const instrumentation_event *event) noexcept {
+    try {
+      thread_local counters local;
+      const instrumentation_key key{type, event};
+      auto it = local.m_counts.find(key);
+      if (it == local.m_counts.end()) {
+        std::lock_guard lock{local.m_mutex};
+        it = local.m_counts.try_emplace(key).first;
+      }
+      auto &count = it->second;
+      count.store(count.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+    } catch (const std::bad_alloc &) {
+    }
+  }
+
+  totals aggregate() {
+    std::lock_guard lock{m_mutex};
+    totals result = m_finished;
+    for (auto *thread : m_threads)
+      add(result, *thread);
+    return result;
+  }
+
+private:
+  void attach(counters *thread) {
+    std::lock_guard lock{m_mutex};
+    m_threads.push_back(thread);
+  }
+
+  // The counts of finished threads are kept
+  void detach(counters *thread) {
+    std::lock_guard lock{m_mutex};
+    add(m_finished, *thread);
+    std::erase(m_threads, thread);
+  }
+
+  static void add(totals &result, counters &thread) {
+    std::lock_guard lock{thread.m_mutex};
+    for (const auto &[key, count] : thread.m_counts)
+      result[key] += count.load(std::memory_order_relaxed);
+  }
+
+  std::mutex m_mutex;
+  std::vector<counters *> m_threads;
+  totals m_finished;
+};
+} // namespace details
+
+#ifdef ERASED_NO_INSTRUMENTATION
+using instrumented = details::no_instrumentation;
+#else
+// Counts, per concrete type, the calls of each behavior, the constructions in
+// the small buffer and on the heap, the copies, the moves and the
+// destructions of basic_erased and ref. Nothing is counted during constant
+// evaluation, and defining ERASED_NO_INSTRUMENTATION removes the policy.
+struct instrumented : details::policy_tag {
+  using kind = details::instrumentation_kind;
+  using entry = details::TypeRecord;
+
+  template <typename T>
+  static constexpr void on_construct(bool is_inline) noexcept {
+    if (!std::is_constant_evaluated())
+      details::instrumentation_registry::record(
+          &details::instrumented_type_v<T>,
+          is_inline ? &details::construct_inline_event
+                    : &details::construct_heap_event);
+  }
+
+  template <typename Method, typename Table>
+  static constexpr void on_invoke(const Table &table) noexcept {
+    if (!std::is_constant_evaluated())
+      details::instrumentation_registry::record(
+          table->template get<details::TypeRecord>(),
+          &details::event_v<Method>);
+  }
+
+  template <typename Table>
+  static constexpr void on_move(const Table &table) noexcept {
+    on_invoke<Move>(table);
+  }
+};
+#endif
+
+struct instrumentation_entry {
+  std::string_view type;
+  std::string_view event;
+  std::uint64_t count;
+
+  constexpr bool operator==(const instrumentation_entry &) const = default;
+};
+
+// Counts of every thread, running or finished, most frequent first
+inline std::vector<instrumentation_entry> instrumentation_snapshot() {
+  std::vector<instrumentation_entry> entries;
+  for (const auto &[key, count] :
+       details::instrumentation_registry::instance().aggregate())
+    entries.push_back({key.first->name, key.second->name, count});
+  std::ranges::sort(entries, [](const auto &lhs, const auto &rhs) {
+    return std::tie(rhs.count, lhs.type, lhs.event) <
+           std::tie(lhs.count, rhs.type, rhs.event);
+  });
+  return entries;
+}
+
+inline void dump_instrumentation(std::ostream &stream) {
+  for (const auto &[type, event, count] : instrumentation_snapshot())
+    stream << type << ' ' << event << ' ' << count << '\n';
+}
+} // namespace erased
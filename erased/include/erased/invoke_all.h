@@ -0,0 +1,139 @@
+#pragma once
+
+#include "erased.h"
+#include "ref.h"
+#include "utils/access.h"
+#include "utils/utils.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+namespace erased {
+namespace details {
+// Number of elements grouped at once, so that the objects, the results and the
+// bookkeeping of a block stay in the L1 cache.
+inline constexpr std::size_t invoke_block_size = 256;
+
+// Number of distinct functions that get a group. The elements calling the
+// others are gathered in a last group, which calls the function of each.
+inline constexpr std::size_t invoke_max_groups = 16;
+
+// Rehashes the count elements from first once the calls of a block returned
+// or threw, when calling Method may leave the hash they cache stale
+template <typename Method, typename Iterator> struct rehash_block_on_exit {
+  using element = std::iter_reference_t<Iterator>;
+
+  constexpr ~rehash_block_on_exit() {
+    if constexpr (access::rehashes_after<Method, element>()) {
+      for (std::size_t i = 0; i < count; ++i, ++first)
+        access::rehash_after<Method>(*first);
+    }
+  }
+
+  Iterator first;
+  std::size_t count;
+};
+
+// Calls Method on every element of range, grouping the elements of each block
+// that call the same function, so that each run of calls goes to a single,
+// well predicted, target. The objects of a block are prefetched while it is
+// gathered, before they are called out of order. sink(index, result) receives
+// the result of the element at index. Nothing is allocated.
+template <bool Prefetch, typename Method, typename Range, typename Sink,
+          typename... Args>
+constexpr void invoke_grouped(Range &range, Sink sink, Args &...args) {
+  using target = decltype(access::target<Method>(*std::ranges::begin(range)));
+  using function = decltype(target::function);
+  using pointer = decltype(target::object);
+
+  // Groups are kept across blocks, few distinct types are expected. The last
+  // end is the one of the elements left out of the groups.
+  std::array<function, invoke_max_groups> groups{};
+  std::size_t group_count = 0;
+  std::array<std::size_t, invoke_max_groups + 1> ends{};
+  std::array<std::size_t, invoke_block_size> group_of{};
+  std::array<function, invoke_block_size> functions{};
+  std::array<pointer, invoke_block_size> objects{};
+  std::array<std::size_t, invoke_block_size> sorted{};
+
+  const auto size = static_cast<std::size_t>(std::ranges::size(range));
+  auto it = std::ranges::begin(range);
+
+  for (std::size_t base = 0; base < size; base += invoke_block_size) {
+    const auto count = std::min(invoke_block_size, size - base);
+    const rehash_block_on_exit<Method, decltype(it)> rehash{it, count};
+    std::ranges::fill(ends, 0);
+
+    // Scans every group instead of stopping at the first match, so that the
+    // lookup has no data dependent branch to mispredict
+    for (std::size_t i = 0; i < count; ++i, ++it) {
+      const auto [key, object] = access::target<Method>(*it);
+      auto found = group_count;
+      for (std::size_t group = 0; group < group_count; ++group)
+        found = groups[group] == key ? group : found;
+      if (found == group_count && group_count < invoke_max_groups)
+        groups[group_count++] = key;
+      ++ends[found];
+      group_of[i] = found;
+      functions[i] = key;
+      objects[i] = object;
+      if constexpr (Prefetch) {
+        if (!std::is_constant_evaluated())
+          ERASED_PREFETCH(object);
+      }
+    }
+
+    // Counting sort by group, that keeps the order of the range in a group
+    std::size_t offset = 0;
+    for (auto &end : ends)
+      offset += std::exchange(end, offset);
+    for (std::size_t i = 0; i < count; ++i)
+      sorted[ends[group_of[i]]++] = i;
+
+    const auto call = [&](function key, std::size_t index) {
+      if constexpr (std::is_void_v<decltype(key(objects[index], args...))>)
+        key(objects[index], args...);
+      else
+        sink(base + index, key(objects[index], args...));
+    };
+    std::size_t i = 0;
+    for (std::size_t group = 0; group < group_count; ++group) {
+      const auto key = groups[group];
+      for (; i < ends[group]; ++i)
+        call(key, sorted[i]);
+    }
+    for (; i < ends[invoke_max_groups]; ++i)
+      call(functions[sorted[i]], sorted[i]);
+  }
+}
+} // namespace details
+
+// Calls Method on every element of a range of basic_erased or ref. Elements
+// are called grouped by concrete type, block by block, not in the order of the
+// range.
+template <bool Prefetch = true, std::ranges::sized_range Range,
+          typename Method, typename... Args>
+constexpr void invoke_all(Range &&range, Method, Args &&...args) {
+  details::invoke_grouped<Prefetch, Method>(
+      range, [](std::size_t, auto &&) {}, args...);
+}
+
+// Same as invoke_all, but writes the result of the i-th element to out[i].
+// Returns the end of the written range.
+template <bool Prefetch = true, std::ranges::sized_range Range,
+          typename Method, std::random_access_iterator Out, typename... Args>
+constexpr Out invoke_all_into(Range &&range, Method, Out out,
+                              Args &&...args) {
+  details::invoke_grouped<Prefetch, Method>(
+      range,
+      [&](std::size_t index, auto &&result) {
+        out[index] = static_cast<decltype(result) &&>(result);
+      },
+      args...);
+  return out + std::ranges::size(range);
+}
+} // namespace erased
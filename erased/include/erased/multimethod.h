@@ -0,0 +1,97 @@
+#pragma once
+
+#include "erased.h"
+#include "ref.h"
+#include "utils/access.h"
+#include "utils/utils.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#define fwd(x) static_cast<decltype(x) &&>(x)
+
+namespace erased {
+// Data behavior giving the index of the concrete type among Ts, or
+// sizeof...(Ts) for the other types. dispatch reads it to find the row or the
+// column of the pair of types in its table.
+template <typename... Ts> struct DispatchIndex {
+  using value_type = std::uint32_t;
+
+  template <typename T>
+  static constexpr value_type value =
+      details::index_in_list<T, Ts...>() < 0
+          ? sizeof...(Ts)
+          : details::index_in_list<T, Ts...>();
+};
+
+namespace details {
+template <typename... Ts>
+DispatchIndex<Ts...> dispatch_index_of(const DispatchIndex<Ts...> &);
+
+// The DispatchIndex among the behaviors of Erased
+template <typename Erased>
+using dispatch_index_t =
+    decltype(dispatch_index_of(std::declval<const Erased &>()));
+
+// Calls Method::invoker on the objects when the pair of types has an
+// overload, and Method::fallback otherwise. void stands for the types of
+// neither list, whose objects are never looked at.
+template <typename Method, typename T, typename U, typename R,
+          typename... Args>
+constexpr R dispatch_entry(const void *lhs, const void *rhs, Args... args) {
+  if constexpr (!std::is_void_v<T> && !std::is_void_v<U>) {
+    if constexpr (requires(const T &t, const U &u) {
+                    Method::invoker(t, u, static_cast<Args>(args)...);
+                  })
+      return Method::invoker(*static_cast<const T *>(lhs),
+                             *static_cast<const U *>(rhs),
+                             static_cast<Args>(args)...);
+  }
+  return Method::fallback(static_cast<Args>(args)...);
+}
+
+template <typename Method, typename R, typename Lhs, typename Rhs,
+          typename... Args>
+struct dispatch_table;
+
+// One row per type of the left list and one column per type of the right
+// list, plus a last row and column for the other types
+template <typename Method, typename R, typename... Ts, typename... Us,
+          typename... Args>
+struct dispatch_table<Method, R, DispatchIndex<Ts...>, DispatchIndex<Us...>,
+                      Args...> {
+  using function = R (*)(const void *, const void *, Args...);
+  using row_type = std::array<function, sizeof...(Us) + 1>;
+
+  template <typename T>
+  static constexpr row_type row{dispatch_entry<Method, T, Us, R, Args...>...,
+                                dispatch_entry<Method, T, void, R, Args...>};
+
+  static constexpr std::array<row_type, sizeof...(Ts) + 1> value{
+      row<Ts>..., row<void>};
+};
+} // namespace details
+
+// Calls Method on the concrete objects of lhs and rhs, basic_erased or ref
+// declaring a DispatchIndex, neither of them empty. Method::invoker is
+// overloaded on pairs of const references to concrete types, followed by
+// args, and Method::fallback(args...) is called for the other pairs. The
+// table of the pairs is built at compile time, so a call is a load of each
+// index, a load from the table and a single indirect call.
+template <typename Method, typename Lhs, typename Rhs, typename... Args>
+constexpr decltype(auto) dispatch(Method, const Lhs &lhs, const Rhs &rhs,
+                                  Args &&...args) {
+  using lhs_index = details::dispatch_index_t<Lhs>;
+  using rhs_index = details::dispatch_index_t<Rhs>;
+  using result = decltype(Method::fallback(fwd(args)...));
+  using table = details::dispatch_table<Method, result, lhs_index, rhs_index,
+                                        Args &&...>;
+  const auto [row, lhs_object] = details::access::target<lhs_index>(lhs);
+  const auto [column, rhs_object] = details::access::target<rhs_index>(rhs);
+  return table::value[row][column](lhs_object, rhs_object, fwd(args)...);
+}
+} // namespace erased
+
+#undef fwd
@@ -0,0 +1,335 @@
+#pragma once
+
+#include "utils/utils.h"
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+
+namespace erased {
+// Stores the function pointers directly inside the object, the way a
+// function_ref does, when the interface has at most MaxEntries of them
+// (built-in ones such as the destructor of basic_erased included).
+// Larger interfaces keep a pointer to a static vtable.
+template <std::size_t MaxEntries = 2>
+struct inline_vtable : details::policy_tag {
+  using kind = details::layout_kind;
+
+  template <typename Vtable>
+  using apply = details::fast_conditional<(Vtable::size <= MaxEntries)>::
+      template apply<details::vtable_value<Vtable>,
+                     details::vtable_pointer<Vtable>>;
+};
+
+// Keeps Method in a second table, reached through the first one, so that the
+// behaviors called often share fewer cache lines. Once a behavior is cold,
+// the copy, the move and the destructor of the erased types are cold too.
+template <typename Method> struct cold : Method {};
+
+namespace details {
+template <typename Method> struct cold_traits<cold<Method>> {
+  static constexpr bool is_marked = true;
+  static constexpr bool is_cold = true;
+  using type = Method;
+};
+
+struct heap_kind {};
+
+// Objects that do not fit in the small buffer are created with new.
+struct new_delete_heap {
+  using allocator_type = std::allocator<std::byte>;
+
+  constexpr new_delete_heap() = default;
+  constexpr new_delete_heap(const allocator_type &) noexcept {}
+
+  constexpr allocator_type get_allocator() const noexcept { return {}; }
+
+  constexpr new_delete_heap select_on_copy() const noexcept { return {}; }
+
+  constexpr bool is_equal(const new_delete_heap &) const noexcept {
+    return true;
+  }
+
+  template <typename T, typename... Args> constexpr T *create(Args &&...args) {
+    return new T{static_cast<Args &&>(args)...};
+  }
+
+  template <typename T> constexpr void dispose(T *ptr) noexcept { delete ptr; }
+};
+
+// Objects that do not fit in the small buffer are created with Allocator.
+// Constant evaluation still uses new and delete.
+template <typename Allocator> struct allocator_heap : private Allocator {
+  using allocator_type = Allocator;
+
+  template <typename T>
+  using traits = std::allocator_traits<Allocator>::template rebind_traits<T>;
+
+  constexpr allocator_heap() = default;
+  constexpr allocator_heap(const allocator_type &allocator) noexcept
+      : Allocator(allocator) {}
+
+  constexpr allocator_type get_allocator() const noexcept { return *this; }
+
+  constexpr allocator_heap select_on_copy() const {
+    return std::allocator_traits<
+        Allocator>::select_on_container_copy_construction(*this);
+  }
+
+  // Memory allocated by other can be released by this heap
+  constexpr bool is_equal(const allocator_heap &other) const noexcept {
+    if constexpr (std::allocator_traits<Allocator>::is_always_equal::value)
+      return true;
+    else
+      return get_allocator() == other.get_allocator();
+  }
+
+  template <typename T, typename... Args> constexpr T *create(Args &&...args) {
+    if (std::is_constant_evaluated())
+      return new T{static_cast<Args &&>(args)...};
+
+    typename traits<T>::allocator_type allocator{get_allocator()};
+    T *ptr = traits<T>::allocate(allocator, 1);
+    try {
+      return ::new (static_cast<void *>(ptr))
+          T{static_cast<Args &&>(args)...};
+    } catch (...) {
+      traits<T>::deallocate(allocator, ptr, 1);
+      throw;
+    }
+  }
+
+  template <typename T> constexpr void dispose(T *ptr) noexcept {
+    if (std::is_constant_evaluated()) {
+      delete ptr;
+    } else {
+      typename traits<T>::allocator_type allocator{get_allocator()};
+      std::destroy_at(ptr);
+      traits<T>::deallocate(allocator, ptr, 1);
+    }
+  }
+};
+
+struct new_delete : policy_tag {
+  using kind = heap_kind;
+  using heap = new_delete_heap;
+};
+
+template <typename... Ts>
+using heap_t = find_policy_t<heap_kind, new_delete, Ts...>::heap;
+
+struct storage_kind {};
+
+// ptr points either inside the buffer or to the heap. The buffer is aligned
+// by basic_erased.
+template <std::size_t Size, std::size_t Alignment> struct pointer_buffer {
+  constexpr void *data(bool) noexcept { return m_ptr; }
+  constexpr const void *data(bool) const noexcept { return m_ptr; }
+
+  constexpr bool is_inline(bool) const noexcept {
+    return m_ptr == m_buffer.data();
+  }
+
+  // The first byte of the buffer, unused by heap objects, tells whether ptr
+  // points to a constant, which is neither moved nor destroyed
+  constexpr bool is_constant() const noexcept {
+    return !is_inline(false) && m_buffer[0] == std::byte{1};
+  }
+
+  constexpr void *inline_data() noexcept { return m_ptr = m_buffer.data(); }
+
+  constexpr void set_heap(void *ptr) noexcept {
+    m_buffer[0] = std::byte{0};
+    m_ptr = ptr;
+  }
+
+  // The whole buffer is initialized, as constinit objects require
+  constexpr void set_constant(const void *ptr) noexcept {
+    m_buffer = {};
+    m_buffer[0] = std::byte{1};
+    m_ptr = const_cast<void *>(ptr);
+  }
+
+  constexpr void reset() noexcept { m_ptr = nullptr; }
+
+  constexpr void relocate(const pointer_buffer &other) noexcept {
+    std::memcpy(inline_data(), other.m_buffer.data(), Size);
+  }
+
+  std::array<std::byte, Size> m_buffer;
+  void *m_ptr = nullptr;
+};
+
+// The heap pointer shares the bytes of the buffer, whether the object is
+// inline is told by the vtable. Constant evaluation always uses the heap.
+template <std::size_t Size, std::size_t Alignment> struct compact_buffer {
+  constexpr void *data(bool stored_inline) noexcept {
+    if (is_inline(stored_inline))
+      return m_buffer.data();
+    return m_heap_ptr;
+  }
+
+  constexpr const void *data(bool stored_inline) const noexcept {
+    if (is_inline(stored_inline))
+      return m_buffer.data();
+    return m_heap_ptr;
+  }
+
+  constexpr bool is_inline(bool stored_inline) const noexcept {
+    return stored_inline && !std::is_constant_evaluated();
+  }
+
+  constexpr void *inline_data() noexcept { return m_buffer.data(); }
+  constexpr void set_heap(void *ptr) noexcept { m_heap_ptr = ptr; }
+  constexpr void reset() noexcept {}
+
+  constexpr void relocate(const compact_buffer &other) noexcept {
+    std::memcpy(m_buffer.data(), other.m_buffer.data(), Size);
+  }
+
+  union {
+    alignas(Alignment) std::array<std::byte, Size> m_buffer;
+    void *m_heap_ptr;
+  };
+};
+
+// Objects are always stored in the buffer, constant evaluation excepted
+template <std::size_t Size, std::size_t Alignment> struct inline_buffer {
+  constexpr void *data(bool) noexcept {
+    if (std::is_constant_evaluated())
+      return m_heap_ptr;
+    return m_buffer.data();
+  }
+
+  constexpr const void *data(bool) const noexcept {
+    if (std::is_constant_evaluated())
+      return m_heap_ptr;
+    return m_buffer.data();
+  }
+
+  constexpr bool is_inline(bool) const noexcept {
+    return !std::is_constant_evaluated();
+  }
+
+  constexpr void *inline_data() noexcept { return m_buffer.data(); }
+  constexpr void set_heap(void *ptr) noexcept { m_heap_ptr = ptr; }
+  constexpr void reset() noexcept {}
+
+  constexpr void relocate(const inline_buffer &other) noexcept {
+    std::memcpy(m_buffer.data(), other.m_buffer.data(), Size);
+  }
+
+  union {
+    alignas(Alignment) std::array<std::byte, Size> m_buffer;
+    void *m_heap_ptr;
+  };
+};
+
+// Instantiated for the types that do not fit in an inline only buffer, so
+// that the diagnostic shows their size and alignment next to the buffer's.
+template <typename T, std::size_t TypeSize, std::size_t TypeAlignment,
+          std::size_t BufferSize, std::size_t BufferAlignment>
+struct check_fits_inline {
+  static_assert(TypeSize <= BufferSize && TypeAlignment <= BufferAlignment,
+                "The type does not fit in the buffer of erased::inplace");
+  static constexpr bool value = true;
+};
+
+struct pointer_storage : policy_tag {
+  using kind = storage_kind;
+  static constexpr bool is_compact = false;
+  static constexpr bool is_inline_only = false;
+  static constexpr std::size_t alignment = alignof(std::max_align_t);
+
+  template <std::size_t Size, std::size_t Alignment>
+  using apply = pointer_buffer<Size, Alignment>;
+};
+
+template <typename... Ts>
+using storage_t = find_policy_t<storage_kind, pointer_storage, Ts...>;
+
+struct instrumentation_kind {};
+
+// Hooks called by basic_erased and ref. By default they do nothing and their
+// vtable entry is a policy, so that it is left out of the vtable.
+struct no_instrumentation : policy_tag {
+  using kind = instrumentation_kind;
+  using entry = no_instrumentation;
+
+  template <typename T> static constexpr void on_construct(bool) noexcept {}
+
+  template <typename Method, typename Table>
+  static constexpr void on_invoke(const Table &) noexcept {}
+
+  template <typename Table>
+  static constexpr void on_move(const Table &) noexcept {}
+};
+
+template <typename... Ts>
+using instrumentation_t =
+    find_policy_t<instrumentation_kind, no_instrumentation, Ts...>;
+
+struct hash_cache_kind {};
+
+// Hashes are computed on every call, and need no vtable entry
+struct no_hash_cache : policy_tag {
+  using kind = hash_cache_kind;
+  static constexpr bool enabled = false;
+
+  template <typename Soo> using entry = no_hash_cache;
+};
+
+template <typename... Ts>
+using hash_cache_t = find_policy_t<hash_cache_kind, no_hash_cache, Ts...>;
+} // namespace details
+
+// basic_erased does not store a pointer to its object next to the buffer, and
+// is aligned on Alignment instead of its size: the pointer size goes to the
+// buffer and the object is not over-aligned in std::optional or structs.
+// Only trivially relocatable types up to Alignment are stored inline, which
+// makes the erased object trivially relocatable itself.
+template <std::size_t Alignment = alignof(void *)>
+struct compact : details::policy_tag {
+  static_assert(Alignment >= alignof(void *),
+                "The heap pointer is stored in the buffer");
+
+  using kind = details::storage_kind;
+  static constexpr bool is_compact = true;
+  static constexpr bool is_inline_only = false;
+  static constexpr std::size_t alignment = Alignment;
+
+  template <std::size_t Size, std::size_t>
+  using apply = details::compact_buffer<Size, Alignment>;
+};
+
+// basic_erased never allocates: constructing it from a type that does not
+// fit in its buffer is a compile time error, and it keeps no pointer to its
+// object. It is aligned on Alignment instead of its size.
+template <std::size_t Alignment = alignof(std::max_align_t)>
+struct inline_only : details::policy_tag {
+  static_assert(Alignment >= alignof(void *),
+                "Constant evaluation stores a pointer in the buffer");
+
+  using kind = details::storage_kind;
+  static constexpr bool is_compact = false;
+  static constexpr bool is_inline_only = true;
+  static constexpr std::size_t alignment = Alignment;
+
+  template <std::size_t Size, std::size_t>
+  using apply = details::inline_buffer<Size, Alignment>;
+};
+
+// Payloads that do not fit in the small buffer of basic_erased are allocated,
+// copied, moved and destroyed through Allocator instead of new and delete.
+// A stateful allocator is stored inside the object, reducing the buffer.
+// Copy construction uses select_on_container_copy_construction, move
+// construction propagates the allocator and assignments keep their own.
+template <typename Allocator>
+struct allocator : details::policy_tag {
+  using kind = details::heap_kind;
+  using heap = details::allocator_heap<Allocator>;
+};
+
+using pmr_allocator = allocator<std::pmr::polymorphic_allocator<std::byte>>;
+} // namespace erased
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "erased.h"
+#include "span_ref.h"
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace erased {
+namespace details {
+template <typename Method, bool is_const = method_to_trait_t<Method>::is_const,
+          typename F = method_ptr<Method>>
+struct segment_loop;
+
+// One vtable entry per behavior: runs the behavior over a whole segment and
+// returns how many elements it went through.
+template <typename Method, bool is_const, typename ReturnType, typename First,
+          typename... Args>
+struct segment_loop<Method, is_const, ReturnType (*)(First, Args...)> {
+  using result_pointer = typename batch_kernel<Method>::result_pointer;
+
+  template <typename Segment>
+  static constexpr std::size_t invoker(Segment &segment, result_pointer out,
+                                       Args... args) {
+    batch_kernel<Method>::run(std::span{segment}, out, args...);
+    return segment.size();
+  }
+};
+
+template <typename Method, typename ReturnType, typename First,
+          typename... Args>
+struct segment_loop<Method, true, ReturnType (*)(First, Args...)> {
+  using result_pointer = typename batch_kernel<Method>::result_pointer;
+
+  template <typename Segment>
+  static constexpr std::size_t invoker(const Segment &segment,
+                                       result_pointer out, Args... args) {
+    return segment_loop<Method, false, ReturnType (*)(First, Args...)>::invoker(
+        segment, out, args...);
+  }
+};
+
+struct segment_size {
+  template <typename Segment>
+  static constexpr std::size_t invoker(const Segment &segment) {
+    return segment.size();
+  }
+};
+} // namespace details
+
+// Heterogeneous container storing each concrete type in its own contiguous
+// std::vector. Behaviors are dispatched once per type segment, the loop over
+// the segment itself is not type erased and uses the batch_invoker of the
+// behavior when it has one.
+// Elements are grouped by type: iteration order is the order in which each
+// type was first inserted, then insertion order within a type.
+template <typename... Methods> class poly_vector {
+  using segment_type = basic_erased<64, details::segment_loop<Methods>...,
+                               details::segment_size, Move>;
+
+public:
+  template <typename T, typename... Args>
+  constexpr T &emplace_back(Args &&...args) {
+    return segment_for<T>().emplace_back(static_cast<Args &&>(args)...);
+  }
+
+  template <typename T> constexpr T &push_back(T x) {
+    return emplace_back<T>(std::move(x));
+  }
+
+  template <typename T> constexpr std::span<T> segment_of() noexcept {
+    if (auto *elements = find<T>())
+      return *elements;
+    return {};
+  }
+
+  template <typename T>
+  constexpr std::span<const T> segment_of() const noexcept {
+    if (auto *elements = find<T>())
+      return *elements;
+    return {};
+  }
+
+  constexpr std::size_t segment_count() const noexcept {
+    return m_segments.size();
+  }
+
+  constexpr std::size_t size() const {
+    std::size_t result = 0;
+    for (const auto &segment : m_segments)
+      result += segment.invoke(details::segment_size{});
+    return result;
+  }
+
+  constexpr bool empty() const { return size() == 0; }
+
+  constexpr void clear() noexcept { m_segments.clear(); }
+
+  template <typename Method, typename... Args>
+  constexpr void for_each(Method, Args &&...args) {
+    for (auto &segment : m_segments)
+      segment.invoke(details::segment_loop<Method>{}, nullptr, args...);
+  }
+
+  template <typename Method, typename... Args>
+  constexpr void for_each(Method, Args &&...args) const {
+    for (const auto &segment : m_segments)
+      segment.invoke(details::segment_loop<Method>{}, nullptr, args...);
+  }
+
+  // Writes one result per element, in iteration order, starting at out.
+  // Returns the end of the written range.
+  template <typename Method, typename Result, typename... Args>
+  constexpr Result *transform(Method, Result *out, Args &&...args) {
+    for (auto &segment : m_segments)
+      out += segment.invoke(details::segment_loop<Method>{}, out, args...);
+    return out;
+  }
+
+  template <typename Method, typename Result, typename... Args>
+  constexpr Result *transform(Method, Result *out, Args &&...args) const {
+    for (const auto &segment : m_segments)
+      out += segment.invoke(details::segment_loop<Method>{}, out, args...);
+    return out;
+  }
+
+private:
+  template <typename T> constexpr std::vector<T> *find() noexcept {
+    for (auto &segment : m_segments)
+      if (auto *elements = any_cast<std::vector<T>>(&segment))
+        return elements;
+    return nullptr;
+  }
+
+  template <typename T> constexpr const std::vector<T> *find() const noexcept {
+    for (const auto &segment : m_segments)
+      if (auto *elements = any_cast<std::vector<T>>(&segment))
+        return elements;
+    return nullptr;
+  }
+
+  template <typename T> constexpr std::vector<T> &segment_for() {
+    if (auto *elements = find<T>())
+      return *elements;
+    auto &segment = m_segments.emplace_back(std::in_place_type<std::vector<T>>);
+    return *any_cast<std::vector<T>>(&segment);
+  }
+
+  std::vector<segment_type> m_segments;
+};
+} // namespace erased
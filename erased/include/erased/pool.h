@@ -0,0 +1,292 @@
+#pragma once
+
+#include "policies.h"
+#include "utils/utils.h"
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace erased {
+// One size class of the pool. Blocks in use by objects, or cached by
+// threads, are blocks - free_blocks.
+struct pool_statistics {
+  std::size_t block_size;
+  std::size_t slabs;
+  std::size_t blocks;
+  std::size_t free_blocks;
+};
+
+namespace details {
+inline constexpr std::size_t pool_min_block_size = 16;
+inline constexpr std::size_t pool_class_count = 7;
+inline constexpr std::size_t pool_max_block_size =
+    pool_min_block_size << (pool_class_count - 1);
+inline constexpr std::size_t pool_slab_size = 64 * 1024;
+// Blocks moved at once between a thread and the shared pool
+inline constexpr std::size_t pool_batch_size = 32;
+
+// Larger or over-aligned types are created with new
+template <typename T>
+constexpr bool pool_fits = sizeof(T) <= pool_max_block_size &&
+                           alignof(T) <= alignof(std::max_align_t);
+
+constexpr std::size_t pool_class_of(std::size_t size) noexcept {
+  std::size_t index = 0;
+  while ((pool_min_block_size << index) < size)
+    ++index;
+  return index;
+}
+
+struct pool_block {
+  pool_block *next;
+};
+
+// Free list of a size class, as a singly linked list of blocks
+struct pool_list {
+  void push(pool_block *block) noexcept {
+    block->next = head;
+    head = block;
+    ++count;
+  }
+
+  pool_block *pop() noexcept {
+    pool_block *block = head;
+    head = block->next;
+    --count;
+    return block;
+  }
+
+  // Moves up to n blocks from the front of other
+  void splice(pool_list &other, std::size_t n) noexcept {
+    while (n-- && other.head)
+      push(other.pop());
+  }
+
+  pool_block *head = nullptr;
+  std::size_t count = 0;
+};
+
+// Slabs of one size class shared by the threads, which take and give back
+// their blocks by batches
+class pool_class {
+public:
+  void init(std::size_t block_size) noexcept { m_block_size = block_size; }
+
+  void take(pool_list &list, std::size_t n) {
+    std::lock_guard lock{m_mutex};
+    if (m_free.count < n)
+      carve_slab();
+    list.splice(m_free, n);
+  }
+
+  void give(pool_list &list, std::size_t n) noexcept {
+    std::lock_guard lock{m_mutex};
+    m_free.splice(list, n);
+  }
+
+  // Releases the slabs when all their blocks are back, and returns the bytes
+  // released
+  std::size_t trim() noexcept {
+    std::lock_guard lock{m_mutex};
+    if (m_free.count != m_blocks)
+      return 0;
+    const auto released = m_slabs.size() * pool_slab_size;
+    release_slabs();
+    return released;
+  }
+
+  pool_statistics statistics() const {
+    std::lock_guard lock{m_mutex};
+    return {m_block_size, m_slabs.size(), m_blocks, m_free.count};
+  }
+
+  ~pool_class() { release_slabs(); }
+
+private:
+  void carve_slab() {
+    m_slabs.reserve(m_slabs.size() + 1);
+    auto *slab = static_cast<std::byte *>(::operator new(pool_slab_size));
+    m_slabs.push_back(slab);
+    const auto count = pool_slab_size / m_block_size;
+    for (std::size_t i = count; i-- > 0;)
+      m_free.push(::new (slab + i * m_block_size) pool_block{});
+    m_blocks += count;
+  }
+
+  void release_slabs() noexcept {
+    for (std::byte *slab : m_slabs)
+      ::operator delete(slab);
+    m_slabs.clear();
+    m_free = {};
+    m_blocks = 0;
+  }
+
+  mutable std::mutex m_mutex;
+  std::size_t m_block_size = 0;
+  std::vector<std::byte *> m_slabs;
+  pool_list m_free;
+  std::size_t m_blocks = 0;
+};
+
+class shared_pool {
+public:
+  // Never destroyed, so that the objects destroyed at exit, in any order,
+  // still give their blocks back
+  static shared_pool &instance() noexcept {
+    static shared_pool &pool = *new shared_pool;
+    return pool;
+  }
+
+  pool_class &size_class(std::size_t index) noexcept {
+    return m_classes[index];
+  }
+
+private:
+  shared_pool() noexcept {
+    for (std::size_t i = 0; i < pool_class_count; ++i)
+      m_classes[i].init(pool_min_block_size << i);
+  }
+
+  std::array<pool_class, pool_class_count> m_classes;
+};
+
+// Free lists of the current thread: allocating and deallocating is a pop and
+// a push, the shared pool is only locked once per batch. The blocks are given
+// back to the shared pool when the thread exits.
+class thread_pool_cache {
+public:
+  // The cache of the calling thread, or null once it was destroyed at the
+  // exit of the thread, before thread_local objects constructed earlier
+  static thread_pool_cache *current() noexcept {
+    thread_local thread_pool_cache cache;
+    return destroyed ? nullptr : &cache;
+  }
+
+  // Blocks of the threads whose cache was destroyed go straight to the shared
+  // pool
+  static void *allocate_block(std::size_t index) {
+    if (thread_pool_cache *cache = current())
+      return cache->allocate(index);
+    pool_list list;
+    shared_pool::instance().size_class(index).take(list, 1);
+    return list.pop();
+  }
+
+  static void deallocate_block(void *ptr, std::size_t index) noexcept {
+    if (thread_pool_cache *cache = current())
+      return cache->deallocate(ptr, index);
+    pool_list list;
+    list.push(static_cast<pool_block *>(ptr));
+    shared_pool::instance().size_class(index).give(list, 1);
+  }
+
+  void *allocate(std::size_t index) {
+    pool_list &list = m_lists[index];
+    if (!list.head)
+      m_pool.size_class(index).take(list, pool_batch_size);
+    return list.pop();
+  }
+
+  void deallocate(void *ptr, std::size_t index) noexcept {
+    pool_list &list = m_lists[index];
+    list.push(static_cast<pool_block *>(ptr));
+    if (list.count >= 2 * pool_batch_size)
+      m_pool.size_class(index).give(list, pool_batch_size);
+  }
+
+  void flush() noexcept {
+    for (std::size_t i = 0; i < pool_class_count; ++i)
+      m_pool.size_class(i).give(m_lists[i], m_lists[i].count);
+  }
+
+  ~thread_pool_cache() {
+    flush();
+    destroyed = true;
+  }
+
+private:
+  // Trivially destructible, so still readable after the cache is destroyed
+  static inline thread_local bool destroyed = false;
+
+  shared_pool &m_pool = shared_pool::instance();
+  std::array<pool_list, pool_class_count> m_lists;
+};
+
+// Objects that do not fit in the small buffer are created in blocks of the
+// pool, falling back to new for the types larger than its largest class.
+// Constant evaluation still uses new and delete.
+struct pool_heap {
+  using allocator_type = std::allocator<std::byte>;
+
+  constexpr pool_heap() = default;
+  constexpr pool_heap(const allocator_type &) noexcept {}
+
+  constexpr allocator_type get_allocator() const noexcept { return {}; }
+
+  constexpr pool_heap select_on_copy() const noexcept { return {}; }
+
+  constexpr bool is_equal(const pool_heap &) const noexcept { return true; }
+
+  template <typename T, typename... Args> constexpr T *create(Args &&...args) {
+    if constexpr (pool_fits<T>) {
+      if (!std::is_constant_evaluated()) {
+        constexpr auto index = pool_class_of(sizeof(T));
+        void *block = thread_pool_cache::allocate_block(index);
+        try {
+          return ::new (block) T{static_cast<Args &&>(args)...};
+        } catch (...) {
+          thread_pool_cache::deallocate_block(block, index);
+          throw;
+        }
+      }
+    }
+    return new T{static_cast<Args &&>(args)...};
+  }
+
+  template <typename T> constexpr void dispose(T *ptr) noexcept {
+    if constexpr (pool_fits<T>) {
+      if (!std::is_constant_evaluated()) {
+        constexpr auto index = pool_class_of(sizeof(T));
+        std::destroy_at(ptr);
+        thread_pool_cache::deallocate_block(ptr, index);
+        return;
+      }
+    }
+    delete ptr;
+  }
+};
+} // namespace details
+
+// Payloads that do not fit in the small buffer of basic_erased are created in
+// fixed size blocks, from 16 to 1024 bytes, carved from 64 KiB slabs. Each
+// thread keeps its own free lists, so that most heap objects cost a pop to
+// create and a push to destroy, even when destroyed by another thread.
+struct pooled : details::policy_tag {
+  using kind = details::heap_kind;
+  using heap = details::pool_heap;
+};
+
+// Statistics of each size class of the pool
+inline std::vector<pool_statistics> pool_snapshot() {
+  std::vector<pool_statistics> statistics;
+  for (std::size_t i = 0; i < details::pool_class_count; ++i)
+    statistics.push_back(
+        details::shared_pool::instance().size_class(i).statistics());
+  return statistics;
+}
+
+// Gives the blocks cached by the calling thread back to the pool, then
+// releases the slabs of the size classes whose blocks are all back. Returns
+// the number of bytes released.
+inline std::size_t pool_trim() noexcept {
+  if (auto *cache = details::thread_pool_cache::current())
+    cache->flush();
+  std::size_t released = 0;
+  for (std::size_t i = 0; i < details::pool_class_count; ++i)
+    released += details::shared_pool::instance().size_class(i).trim();
+  return released;
+}
+} // namespace erased
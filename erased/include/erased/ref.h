@@ -1,5 +1,7 @@
 #pragma once
 
+#include "policies.h"
+#include "utils/access.h"
 #include "utils/utils.h"
 #include <memory>
 #include <tuple>
@@ -20,20 +22,116 @@ template <typename T> constexpr auto is_ref_v = is_ref<T>::value;
 template <typename T>
 concept ref_concept = is_ref_v<std::decay_t<T>>;
 
+// Data behavior of basic_erased storing the vtable of Ref for the concrete
+// type, so that the erased object converts to a Ref pointing straight at its
+// object, whatever the layout of Ref. The view is const when Ref only has
+// const behaviors.
+template <typename Ref> struct view {
+  using value_type = details::access::ref_layout<Ref>;
+  static constexpr bool is_const = details::access::ref_all_const<Ref>;
+
+  template <typename T>
+  static constexpr value_type value = value_type::template for_type<T>();
+};
+
+namespace details {
+// How Ref gets the vtable of the object of Erased, if it can: from the
+// view<Ref> entry of Erased, or, for an inline vtable, by copying the
+// function pointers of Erased.
+template <typename Ref, typename Layout, typename Erased> struct projection {
+  static constexpr bool stored = false;
+  static constexpr bool possible = false;
+};
+
+template <typename Ref, typename Layout, int Size, typename... Methods>
+struct projection<Ref, Layout, basic_erased<Size, Methods...>> {
+  static constexpr bool stored = index_in_list<view<Ref>, Methods...>() >= 0;
+  static constexpr bool possible = stored;
+
+  template <typename Table>
+  static constexpr Layout layout(const Table &table) noexcept {
+    return table->template get<view<Ref>>();
+  }
+};
+
+template <typename Ref, typename... Entries, int Size, typename... Methods>
+struct projection<Ref, vtable_value<vtable<Entries...>>,
+                  basic_erased<Size, Methods...>> {
+  static constexpr bool stored = index_in_list<view<Ref>, Methods...>() >= 0;
+  static constexpr bool possible =
+      stored || ((index_in_list<Entries, Methods...>() >= 0) && ...);
+
+  template <typename Table>
+  static constexpr vtable_value<vtable<Entries...>>
+  layout(const Table &table) noexcept {
+    if constexpr (stored)
+      return table->template get<view<Ref>>();
+    else
+      return {vtable<Entries...>{table->template get<Entries>()...}};
+  }
+};
+} // namespace details
+
 template <typename... Methods> class ref : public Methods... {
-  static constexpr auto all_const =
-      (details::method_to_trait_t<Methods>::is_const && ...);
+  using instrumentation = details::instrumentation_t<Methods...>;
+  using vtable =
+      details::vtable_for_t<Methods..., typename instrumentation::entry>;
+  using layout = details::vtable_layout_t<vtable, Methods...>;
+
+  static constexpr auto all_const = vtable::all_const;
+
+  template <typename Erased>
+  using projection =
+      details::projection<ref, layout, std::remove_const_t<Erased>>;
+
+  // Whether the ref may point at the object of Erased, a basic_erased that
+  // may be const. Calls that may modify the object bypass basic_erased::invoke
+  // once projected, which would leave a cached hash stale.
+  template <typename Erased> static consteval bool projects() {
+    if constexpr (!projection<Erased>::possible)
+      return false;
+    else if constexpr (std::is_const_v<Erased>)
+      return all_const;
+    else
+      return all_const || !Erased::soo::hash_cache::enabled;
+  }
 
-  using vtable = details::vtable<Methods...>;
+  // Whether building the ref from Erased projects it, see project
+  template <typename Erased>
+  static constexpr bool views =
+      projection<Erased>::stored && projects<Erased>();
 
 public:
+  // A const object has the vtable of its type, so that is and any_cast find
+  // it. Only refs with const behaviors point at it.
   template <typename T>
+    requires(!std::is_function_v<T>)
   constexpr ref(T &object) noexcept
       : m_ptr{std::addressof(object)},
-        m_vtable{vtable::template construct_for<T>()} {}
+        m_vtable{layout::template for_type<std::remove_const_t<T>>()} {}
+
+  // A function is pointed at by its own address, which outlives the ref
+  template <typename F>
+    requires std::is_function_v<F>
+  ref(F &function) noexcept
+      : m_ptr{reinterpret_cast<decltype(m_ptr)>(&function)},
+        m_vtable{layout::template for_type<F>()} {}
+
+  // An erased object declaring view<ref> is projected, see project. Other
+  // erased objects are pointed at as any object.
+  template <int Size, typename... M>
+    requires views<basic_erased<Size, M...>>
+  constexpr ref(basic_erased<Size, M...> &object) noexcept
+      : ref{details::access::project<ref>(object)} {}
+
+  template <int Size, typename... M>
+    requires views<const basic_erased<Size, M...>>
+  constexpr ref(const basic_erased<Size, M...> &object) noexcept
+      : ref{details::access::project<ref>(object)} {}
 
   template <typename Method, typename... Args>
   constexpr decltype(auto) invoke(Method, Args &&...args) const {
+    instrumentation::template on_invoke<Method>(m_vtable);
     return m_vtable->template get<Method>()(m_ptr, static_cast<Args>(args)...);
   }
 
@@ -46,16 +144,41 @@ public:
   template <typename T, ref_concept Erased>
   friend constexpr auto &any_cast(Erased &&object);
 
+  friend struct details::access;
+
 private:
+  template <typename Pointer>
+  constexpr ref(Pointer ptr, layout vtable) noexcept
+      : m_ptr{ptr}, m_vtable{vtable} {}
+
   details::fast_conditional<all_const>::template apply<const void *, void *>
       m_ptr;
-  const vtable *m_vtable;
+  layout m_vtable;
 };
 
+// Ref pointing at the object stored by an erased object instead of the erased
+// object, so that calls do not go through both vtables. Ref needs the erased
+// type to declare view<Ref>, or an inline vtable of behaviors of the erased
+// type. The ref is left dangling by whatever replaces or moves the stored
+// object: assignments, emplace, swap, destruction, and moves of an inline
+// object. Its calls bypass the instrumentation of the erased object. An empty
+// erased object gives an empty ref.
+template <ref_concept Ref, int Size, typename... Methods>
+  requires(details::access::projects<Ref, basic_erased<Size, Methods...>>())
+constexpr Ref project(basic_erased<Size, Methods...> &object) noexcept {
+  return details::access::project<Ref>(object);
+}
+
+template <ref_concept Ref, int Size, typename... Methods>
+  requires(
+      details::access::projects<Ref, const basic_erased<Size, Methods...>>())
+constexpr Ref project(const basic_erased<Size, Methods...> &object) noexcept {
+  return details::access::project<Ref>(object);
+}
+
 template <typename T, typename... Methods>
 constexpr bool is(const ref<Methods...> &object) {
-  return object.m_vtable ==
-         ref<Methods...>::vtable::template construct_for<T>();
+  return object.m_vtable.template holds<T>();
 }
 
 template <typename T, ref_concept Erased>
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "erased.h"
+#include "ref.h"
+#include "utils/access.h"
+#include "utils/utils.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace erased {
+// Records of an archive, and so their payloads, are aligned on this, provided
+// that the archive is, as a memory mapped file or a std::vector is.
+inline constexpr std::size_t archive_alignment = 16;
+
+// Header of a record, followed by size bytes of payload and by zeros up to the
+// next record. Archives are only readable by the same platform.
+struct record_header {
+  std::uint64_t id;
+  std::uint64_t size;
+};
+
+class archive_error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+namespace details {
+template <typename T>
+concept self_serializing =
+    requires(const T &object, std::vector<std::byte> &archive) {
+      object.serialize(archive);
+    };
+
+template <typename T>
+concept self_deserializing = requires(std::span<const std::byte> payload) {
+  { T::deserialize(payload) } -> std::same_as<T>;
+};
+
+// Trivially copyable objects are their bytes, unless they serialize
+// themselves
+template <typename T>
+concept bytewise_serializable =
+    std::is_trivially_copyable_v<T> && !self_serializing<T> &&
+    alignof(T) <= archive_alignment;
+
+constexpr std::size_t archive_padded(std::size_t size) noexcept {
+  return (size + archive_alignment - 1) / archive_alignment *
+         archive_alignment;
+}
+
+template <typename T, typename Byte> auto *start_lifetime_as(Byte *bytes) {
+#ifdef __cpp_lib_start_lifetime_as
+  return std::start_lifetime_as<T>(bytes);
+#else
+  using object_type = std::conditional_t<std::is_const_v<Byte>, const T, T>;
+  return std::launder(reinterpret_cast<object_type *>(bytes));
+#endif
+}
+
+template <typename Byte> struct record_view {
+  std::uint64_t id;
+  std::span<Byte> payload;
+};
+
+template <typename Byte>
+record_view<Byte> parse_record(std::span<Byte> record) {
+  record_header header;
+  if (record.size() < sizeof(header))
+    throw archive_error{"erased: truncated record header"};
+  std::memcpy(&header, record.data(), sizeof(header));
+  if (header.size > record.size() - sizeof(header))
+    throw archive_error{"erased: truncated record payload"};
+  return {header.id, record.subspan(sizeof(header), header.size)};
+}
+} // namespace details
+
+// Behavior appending the object to an archive: its bytes if it is trivially
+// copyable, otherwise what its serialize(std::vector<std::byte> &) member
+// appends. The latter objects are loaded by a static deserialize member.
+struct Serialize {
+  template <typename T>
+  static void invoker(const T &self, std::vector<std::byte> &archive) {
+    if constexpr (details::self_serializing<T>) {
+      self.serialize(archive);
+    } else {
+      static_assert(details::bytewise_serializable<T>,
+                    "The type must be trivially copyable or serialize itself");
+      const auto *bytes =
+          reinterpret_cast<const std::byte *>(std::addressof(self));
+      archive.insert(archive.end(), bytes, bytes + sizeof(T));
+    }
+  }
+};
+
+// Data behavior giving the id of the concrete type in Registry
+template <typename Registry> struct StableId {
+  using value_type = std::uint64_t;
+
+  template <typename T>
+  static constexpr value_type value = Registry::template id<T>;
+};
+
+// Assigns to each type of Ts its index as a stable id. Types may be appended,
+// but not removed nor reordered, for older archives to remain readable.
+template <typename... Ts> struct type_registry {
+  template <typename T> static consteval std::uint64_t id_of() {
+    constexpr int index = details::index_in_list<T, Ts...>();
+    static_assert(index >= 0, "The type is not in the registry");
+    return index;
+  }
+
+  template <typename T> static constexpr std::uint64_t id = id_of<T>();
+
+  // Appends a record holding the object of a basic_erased or a ref, which
+  // needs the Serialize and StableId<type_registry> behaviors
+  template <typename Object>
+  static void save(const Object &object, std::vector<std::byte> &archive) {
+    const auto start = archive.size();
+    archive.resize(start + sizeof(record_header));
+    object.invoke(Serialize{}, archive);
+    const record_header header{
+        details::access::entry<StableId<type_registry>>(object),
+        archive.size() - start - sizeof(record_header)};
+    std::memcpy(archive.data() + start, &header, sizeof(header));
+    archive.resize(start + sizeof(header) +
+                   details::archive_padded(header.size));
+  }
+
+  // Erased holding a copy of the object of the record. Trivially copyable
+  // objects are copied from the record, without allocating when they fit in
+  // the buffer of Erased.
+  template <typename Erased>
+  static Erased load(std::span<const std::byte> record) {
+    constexpr Erased (*loaders[])(std::span<const std::byte>) = {
+        &load_as<Erased, Ts>...};
+    const auto [type_id, payload] = details::parse_record(record);
+    if (type_id >= sizeof...(Ts))
+      throw archive_error{"erased: unknown type id"};
+    return loaders[type_id](payload);
+  }
+
+  // Ref pointing at the trivially copyable object of the record, which is
+  // neither copied nor allocated: the record must outlive the ref.
+  template <typename Ref, typename Byte>
+  static Ref view(std::span<Byte> record) {
+    constexpr Ref (*viewers[])(std::span<Byte>) = {
+        &view_as<Ref, Ts, Byte>...};
+    const auto [type_id, payload] = details::parse_record(record);
+    if (type_id >= sizeof...(Ts))
+      throw archive_error{"erased: unknown type id"};
+    return viewers[type_id](payload);
+  }
+
+private:
+  template <typename T> static void check_size(std::size_t size) {
+    if (size != sizeof(T))
+      throw archive_error{"erased: the size of the payload does not match"};
+  }
+
+  template <typename Erased, typename T>
+  static Erased load_as(std::span<const std::byte> payload) {
+    if constexpr (details::self_deserializing<T>) {
+      return Erased{std::in_place_type<T>, T::deserialize(payload)};
+    } else {
+      static_assert(details::bytewise_serializable<T>,
+                    "The type must be trivially copyable or deserialize "
+                    "itself");
+      check_size<T>(payload.size());
+      // Copied bytewise, the payload may not be aligned for T
+      std::array<std::byte, sizeof(T)> bytes;
+      std::ranges::copy(payload, bytes.begin());
+      return Erased{std::in_place_type<T>, std::bit_cast<T>(bytes)};
+    }
+  }
+
+  template <typename Ref, typename T, typename Byte>
+  static Ref view_as(std::span<Byte> payload) {
+    if constexpr (details::bytewise_serializable<T>) {
+      check_size<T>(payload.size());
+      if (reinterpret_cast<std::uintptr_t>(payload.data()) % alignof(T) != 0)
+        throw archive_error{"erased: the payload is not aligned for the type"};
+      return Ref{*details::start_lifetime_as<T>(payload.data())};
+    } else {
+      throw archive_error{"erased: the type cannot be viewed in place"};
+    }
+  }
+};
+
+// Calls f with each record of the archive, as a std::span of its bytes
+template <typename Archive, typename F>
+void for_each_record(Archive &&archive, F &&f) {
+  std::span bytes{archive};
+  while (!bytes.empty()) {
+    const auto payload = details::parse_record(bytes).payload;
+    const auto length = std::min(
+        bytes.size(), sizeof(record_header) +
+                          details::archive_padded(payload.size()));
+    f(bytes.first(length));
+    bytes = bytes.subspan(length);
+  }
+}
+} // namespace erased
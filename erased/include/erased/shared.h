@@ -0,0 +1,217 @@
+#pragma once
+
+#include "erased.h"
+#include "utils/utils.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+#define fwd(x) static_cast<decltype(x) &&>(x)
+
+namespace erased {
+namespace details {
+// Intrusive reference count, atomic outside of constant evaluation
+struct shared_count {
+  constexpr void acquire() noexcept {
+    if (std::is_constant_evaluated())
+      ++m_count;
+    else
+      std::atomic_ref{m_count}.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Returns true when the last reference was released
+  constexpr bool release() noexcept {
+    if (std::is_constant_evaluated())
+      return --m_count == 0;
+    return std::atomic_ref{m_count}.fetch_sub(1, std::memory_order_acq_rel) ==
+           1;
+  }
+
+  constexpr std::size_t use_count() const noexcept {
+    if (std::is_constant_evaluated())
+      return m_count;
+    return std::atomic_ref{const_cast<std::size_t &>(m_count)}.load(
+        std::memory_order_acquire);
+  }
+
+  alignas(std::atomic_ref<std::size_t>::required_alignment) std::size_t
+      m_count = 1;
+};
+
+// The reference count and the object share a single allocation
+template <typename T> struct shared_block : shared_count {
+  template <typename... Args>
+  constexpr shared_block(Args &&...args) : m_object{fwd(args)...} {}
+
+  T m_object;
+};
+
+template <typename... Methods> struct shared_storage {
+  using vtable =
+      details::vtable_for_t<bind_storage_t<Methods, shared_storage>...,
+                            Destructor<shared_storage>>;
+  using layout = details::vtable_layout_t<vtable, Methods...>;
+
+  void *m_ptr = nullptr;
+  shared_count *m_count = nullptr;
+  layout table{};
+
+  template <typename T, typename... Args>
+  constexpr T *construct(Args &&...args) {
+    auto *block = new shared_block<T>{fwd(args)...};
+    m_count = block;
+    m_ptr = std::addressof(block->m_object);
+    table = layout::template for_type<T>();
+    return std::addressof(block->m_object);
+  }
+
+  template <typename T> constexpr void destroy() noexcept {
+    delete static_cast<shared_block<T> *>(m_count);
+  }
+
+  constexpr bool has_value() const noexcept { return !table.empty(); }
+
+  constexpr void release() noexcept {
+    if (has_value() && m_count->release())
+      table->template get<Destructor<shared_storage>>()(m_ptr, this);
+    *this = {};
+  }
+};
+} // namespace details
+
+template <typename... Methods> class shared;
+
+template <typename T> struct is_shared : std::false_type {};
+
+template <typename... Methods>
+struct is_shared<shared<Methods...>> : std::true_type {};
+
+template <typename T> constexpr bool is_shared_v = is_shared<T>::value;
+
+template <typename T>
+concept shared_concept = is_shared_v<std::decay_t<T>>;
+
+// Erased object with shared ownership: copies only increment a reference
+// count stored in the same allocation as the object.
+// With the Copy behavior, non const behaviors are copy-on-write: a shared
+// object is copied before being modified. Without it, they modify the object
+// seen by all the copies.
+template <typename... Methods> class shared : public Methods... {
+  using storage = details::shared_storage<Methods...>;
+
+public:
+  static constexpr bool copy_on_write = details::contains<Copy, Methods...>();
+
+  template <typename T>
+  constexpr shared(std::in_place_type_t<T>, auto &&...args) {
+    m_storage.template construct<T>(fwd(args)...);
+  }
+
+  template <typename T>
+  constexpr shared(T x)
+      : shared{std::in_place_type<T>, static_cast<T &&>(x)} {}
+
+  template <typename Method>
+  constexpr decltype(auto) invoke(Method, auto &&...xs) const {
+    return m_storage.table->template get<Method>()(
+        static_cast<const void *>(m_storage.m_ptr), fwd(xs)...);
+  }
+
+  template <typename Method>
+  constexpr decltype(auto) invoke(Method, auto &&...xs) {
+    if constexpr (copy_on_write &&
+                  !details::method_to_trait_t<Method>::is_const)
+      detach();
+    return m_storage.table->template get<Method>()(m_storage.m_ptr,
+                                                   fwd(xs)...);
+  }
+
+  constexpr shared(const shared &other) noexcept
+      : m_storage{other.m_storage} {
+    if (has_value())
+      m_storage.m_count->acquire();
+  }
+
+  // The moved-from object is left empty
+  constexpr shared(shared &&other) noexcept
+      : m_storage{std::exchange(other.m_storage, {})} {}
+
+  constexpr shared &operator=(const shared &other) noexcept {
+    shared{other}.swap(*this);
+    return *this;
+  }
+
+  constexpr shared &operator=(shared &&other) noexcept {
+    shared{std::move(other)}.swap(*this);
+    return *this;
+  }
+
+  constexpr void swap(shared &other) noexcept {
+    std::swap(m_storage, other.m_storage);
+  }
+
+  friend constexpr void swap(shared &lhs, shared &rhs) noexcept {
+    lhs.swap(rhs);
+  }
+
+  constexpr bool has_value() const noexcept { return m_storage.has_value(); }
+
+  constexpr std::size_t use_count() const noexcept {
+    return has_value() ? m_storage.m_count->use_count() : 0;
+  }
+
+  // Gives this handle its own copy of the object if it is shared
+  constexpr void detach()
+    requires copy_on_write
+  {
+    if (use_count() > 1) {
+      storage copy;
+      std::as_const(*this).invoke(Copy::for_storage<storage>{}, &copy);
+      m_storage.release();
+      m_storage = copy;
+    }
+  }
+
+  constexpr ~shared() { m_storage.release(); }
+
+  template <typename T, typename... M>
+  friend constexpr bool is(const shared<M...> &object);
+
+  template <typename T, shared_concept Shared>
+  friend constexpr auto *any_cast(Shared *object);
+
+  template <typename T, shared_concept Shared>
+  friend constexpr auto &&any_cast(Shared &&object);
+
+private:
+  storage m_storage;
+};
+
+template <typename T, typename... Methods>
+constexpr bool is(const shared<Methods...> &object) {
+  return object.m_storage.table.template holds<T>();
+}
+
+// Non const access detaches a copy-on-write object first
+template <typename T, shared_concept Shared>
+constexpr auto *any_cast(Shared *object) {
+  using pointer = std::conditional_t<std::is_const_v<Shared>, const T *, T *>;
+  if (!is<T>(*object))
+    return pointer{nullptr};
+  if constexpr (!std::is_const_v<Shared> && Shared::copy_on_write)
+    object->detach();
+  return static_cast<pointer>(object->m_storage.m_ptr);
+}
+
+template <typename T, shared_concept Shared>
+constexpr auto &&any_cast(Shared &&object) {
+  if (auto *ptr = any_cast<T>(std::addressof(object)))
+    return std::forward_like<Shared>(*ptr);
+  throw std::bad_cast();
+}
+} // namespace erased
+
+#undef fwd
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "utils/utils.h"
+#include <cstddef>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <type_traits>
+
+namespace erased {
+namespace details {
+template <typename Method, typename F = method_ptr<Method>> struct batch_kernel;
+
+// Runs a behavior over a contiguous range of objects of the same type: through
+// the batch_invoker of the behavior when it has one for that type, through a
+// loop over its invoker otherwise.
+// A batch_invoker takes the objects as a std::span<const T> (std::span<T> for
+// non const behaviors), then a std::span<ReturnType> for the results unless the
+// behavior returns void, then the arguments of the behavior.
+template <typename Method, typename ReturnType, typename First,
+          typename... Args>
+struct batch_kernel<Method, ReturnType (*)(First, Args...)> {
+  static constexpr bool is_const = method_to_trait_t<Method>::is_const;
+
+  using result_pointer =
+      fast_conditional<std::is_void_v<ReturnType>>::template apply<std::nullptr_t,
+                                                                   ReturnType *>;
+
+  template <typename T>
+  using objects_type = std::span<
+      typename fast_conditional<is_const>::template apply<const T, T>>;
+
+  template <typename T>
+  static constexpr void run(std::span<T> span, result_pointer out,
+                            Args... args) {
+    const objects_type<std::remove_const_t<T>> objects = span;
+
+    if constexpr (std::is_void_v<ReturnType>) {
+      if constexpr (requires { Method::batch_invoker(objects, args...); }) {
+        Method::batch_invoker(objects, args...);
+      } else {
+        for (auto &object : objects)
+          Method::invoker(object, args...);
+      }
+    } else {
+      using results_type = std::span<ReturnType>;
+      if constexpr (requires {
+                      Method::batch_invoker(objects, results_type{}, args...);
+                    }) {
+        if (out != nullptr) {
+          Method::batch_invoker(objects, results_type{out, objects.size()},
+                                args...);
+          return;
+        }
+      }
+
+      if (out == nullptr) {
+        for (auto &object : objects)
+          Method::invoker(object, args...);
+      } else {
+        for (auto &object : objects)
+          *out++ = Method::invoker(object, args...);
+      }
+    }
+  }
+};
+
+template <typename Method, bool is_const = method_to_trait_t<Method>::is_const,
+          typename F = method_ptr<Method>>
+struct batch_call;
+
+// One vtable entry of span_ref per behavior. The first object of the span is
+// the erased object, so that create_invoker_for recovers its concrete type.
+template <typename Method, typename ReturnType, typename First,
+          typename... Args>
+struct batch_call<Method, false, ReturnType (*)(First, Args...)> {
+  using result_pointer = typename batch_kernel<Method>::result_pointer;
+
+  template <typename T>
+  static constexpr void invoker(T &first, std::size_t count,
+                                result_pointer out, Args... args) {
+    batch_kernel<Method>::run(std::span<T>{std::addressof(first), count}, out,
+                              args...);
+  }
+};
+
+template <typename Method, typename ReturnType, typename First,
+          typename... Args>
+struct batch_call<Method, true, ReturnType (*)(First, Args...)> {
+  using result_pointer = typename batch_kernel<Method>::result_pointer;
+
+  template <typename T>
+  static constexpr void invoker(const T &first, std::size_t count,
+                                result_pointer out, Args... args) {
+    batch_kernel<Method>::run(std::span<const T>{std::addressof(first), count},
+                              out, args...);
+  }
+};
+} // namespace details
+
+template <typename... Methods> class span_ref;
+
+template <typename T> struct is_span_ref : std::false_type {};
+
+template <typename... Methods>
+struct is_span_ref<span_ref<Methods...>> : std::true_type {};
+
+template <typename T> constexpr auto is_span_ref_v = is_span_ref<T>::value;
+
+// Non owning reference to a contiguous range of objects of the same concrete
+// type. A behavior is called on the whole range through a single indirect
+// call, that runs its batch_invoker or an inlined loop over its invoker.
+template <typename... Methods> class span_ref {
+  using vtable = details::vtable_for_t<details::batch_call<Methods>...>;
+  using layout = details::vtable_pointer<vtable>;
+
+  static constexpr auto all_const = vtable::all_const;
+
+public:
+  template <std::ranges::contiguous_range Range>
+    requires std::ranges::sized_range<Range> &&
+             (!is_span_ref_v<std::remove_cvref_t<Range>>) &&
+             (all_const || !std::is_const_v<std::remove_reference_t<
+                               std::ranges::range_reference_t<Range>>>)
+  constexpr span_ref(Range &&range) noexcept
+      : m_first{std::ranges::data(range)},
+        m_size{static_cast<std::size_t>(std::ranges::size(range))},
+        m_vtable{
+            layout::template for_type<std::ranges::range_value_t<Range>>()} {}
+
+  constexpr std::size_t size() const noexcept { return m_size; }
+
+  constexpr bool empty() const noexcept { return m_size == 0; }
+
+  template <typename Method, typename... Args>
+  constexpr void for_each(Method, Args &&...args) const {
+    if (m_size != 0)
+      m_vtable->template get<details::batch_call<Method>>()(
+          m_first, m_size, nullptr, static_cast<Args &&>(args)...);
+  }
+
+  // Writes one result per object, in order, starting at out.
+  // Returns the end of the written range.
+  template <typename Method, typename Result, typename... Args>
+  constexpr Result *transform(Method, Result *out, Args &&...args) const {
+    if (m_size != 0)
+      m_vtable->template get<details::batch_call<Method>>()(
+          m_first, m_size, out, static_cast<Args &&>(args)...);
+    return out + m_size;
+  }
+
+  template <typename T, typename... M>
+  friend constexpr bool is(const span_ref<M...> &objects);
+
+private:
+  details::fast_conditional<all_const>::template apply<const void *, void *>
+      m_first;
+  std::size_t m_size;
+  layout m_vtable;
+};
+
+template <typename T, typename... Methods>
+constexpr bool is(const span_ref<Methods...> &objects) {
+  return objects.m_vtable.template holds<T>();
+}
+} // namespace erased
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "utils.h"
+#include <type_traits>
+#include <utility>
+
+namespace erased {
+template <int Size, typename... Methods> struct basic_erased;
+
+template <typename... Methods> class ref;
+
+namespace details {
+template <typename Ref, typename Layout, typename Erased> struct projection;
+
+struct access {
+  // The function called by Method and the object it is called on
+  template <typename Method, int Size, typename... Methods>
+  static constexpr auto target(basic_erased<Size, Methods...> &object) {
+    return target_type{object.m_soo.table->template get<Method>(),
+                       object.m_soo.data()};
+  }
+
+  template <typename Method, int Size, typename... Methods>
+  static constexpr auto target(const basic_erased<Size, Methods...> &object) {
+    return target_type{object.m_soo.table->template get<Method>(),
+                       object.m_soo.data()};
+  }
+
+  template <typename Method, typename... Methods>
+  static constexpr auto target(const ref<Methods...> &object) {
+    return target_type{object.m_vtable->template get<Method>(), object.m_ptr};
+  }
+
+  // The value of the data behavior Method for the object
+  template <typename Method, int Size, typename... Methods>
+  static constexpr auto entry(const basic_erased<Size, Methods...> &object) {
+    return object.m_soo.table->template get<Method>();
+  }
+
+  template <typename Method, typename... Methods>
+  static constexpr auto entry(const ref<Methods...> &object) {
+    return object.m_vtable->template get<Method>();
+  }
+
+  // Whether calling Method on object may leave the hash it caches stale
+  template <typename Method, typename Object>
+  static consteval bool rehashes_after() {
+    if constexpr (requires { std::declval<Object &>().m_soo; } &&
+                  !std::is_const_v<std::remove_reference_t<Object>>)
+      return std::remove_cvref_t<decltype(std::declval<Object &>().m_soo)>::
+          template rehashes_after<Method>();
+    else
+      return false;
+  }
+
+  // Refreshes the cached hash of object, once Method was called on it
+  template <typename Method, typename Object>
+  static constexpr void rehash_after(Object &object) noexcept {
+    if constexpr (rehashes_after<Method, Object>()) {
+      if (object.m_soo.has_value())
+        object.m_soo.rehash();
+    }
+  }
+
+  template <typename Ref> using ref_layout = typename Ref::layout;
+
+  template <typename Ref> static constexpr bool ref_all_const = Ref::all_const;
+
+  // Whether project may point Ref at the object of Erased
+  template <typename Ref, typename Erased> static consteval bool projects() {
+    return Ref::template projects<Erased>();
+  }
+
+  // Ref pointing straight at the object of an erased object, with a vtable
+  // built from the vtable of the erased object. An empty erased object gives
+  // an empty vtable.
+  template <typename Ref, typename Erased>
+  static constexpr Ref project(Erased &object) noexcept {
+    using projection =
+        details::projection<Ref, ref_layout<Ref>, std::remove_const_t<Erased>>;
+    if (!object.m_soo.has_value())
+      return Ref{decltype(object.m_soo.data()){nullptr}, ref_layout<Ref>{}};
+    return Ref{object.m_soo.data(), projection::layout(object.m_soo.table)};
+  }
+
+private:
+  template <typename Function, typename Pointer> struct target_type {
+    Function function;
+    Pointer object;
+  };
+};
+} // namespace details
+} // namespace erased
@@ -1,12 +1,24 @@
 #pragma once
 
-#include <array>
+#include <cstddef>
 #include <tuple>
 #include <type_traits>
 
+#if defined(_MSC_VER) && !defined(__clang__)
+#define ERASED_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#define ERASED_PREFETCH(address) ((void)(address))
+#else
+#define ERASED_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#define ERASED_PREFETCH(address) __builtin_prefetch(address)
+#endif
+
 namespace erased::details {
 struct erased_type_t {};
 
+// Gives the algorithms of the library access to the object and the vtable of
+// the erased types.
+struct access;
+
 template <bool condition> struct fast_conditional {
   template <typename T, typename F> using apply = T;
 };
@@ -29,7 +41,13 @@ struct method_to_trait<Method, ReturnType (*)(ErasedType &, Args...)> {
 
   template <typename T> static constexpr auto create_invoker_for() {
     return +[](first_argument first, Args... args) {
-      if constexpr (is_const) {
+      // Functions are pointed at by their own address, see ref
+      if constexpr (std::is_function_v<T>) {
+        return Method::invoker(
+            *reinterpret_cast<T *>(const_cast<void *>(
+                static_cast<const void *>(first))),
+            static_cast<Args &&>(args)...);
+      } else if constexpr (is_const) {
         return Method::invoker(*static_cast<const T *>(first),
                                static_cast<Args &&>(args)...);
       } else {
@@ -40,36 +58,296 @@ struct method_to_trait<Method, ReturnType (*)(ErasedType &, Args...)> {
   }
 };
 
+// noexcept invokers are stored as plain function pointers
+template <typename Method, typename ErasedType, typename ReturnType,
+          typename... Args>
+struct method_to_trait<Method, ReturnType (*)(ErasedType &, Args...) noexcept>
+    : method_to_trait<Method, ReturnType (*)(ErasedType &, Args...)> {};
+
+// A data behavior stores a compile time value computed from the concrete type
+// in the vtable, instead of a function pointer. value<T> is only instantiated
+// for the stored types, so it may depend on the storage being complete. It
+// is const unless its is_const member says otherwise, as a view giving
+// mutable access to the object.
+template <typename Method>
+concept data_behavior = requires { typename Method::value_type; };
+
+template <typename Method> consteval bool data_is_const() {
+  if constexpr (requires { Method::is_const; })
+    return Method::is_const;
+  else
+    return true;
+}
+
+template <typename Method> struct data_to_trait {
+  static constexpr bool is_const = data_is_const<Method>();
+
+  using type = typename Method::value_type;
+
+  template <typename T> static constexpr type create_invoker_for() {
+    return Method::template value<T>;
+  }
+};
+
+template <typename Method> struct method_to_trait_selector {
+  using type =
+      method_to_trait<Method,
+                      decltype(&Method::template invoker<erased_type_t>)>;
+};
+
+template <data_behavior Method> struct method_to_trait_selector<Method> {
+  using type = data_to_trait<Method>;
+};
+
 template <typename Method>
-using method_to_trait_t =
-    method_to_trait<Method, decltype(&Method::template invoker<erased_type_t>)>;
+using method_to_trait_t = typename method_to_trait_selector<Method>::type;
 
 template <typename Method>
 using method_ptr = typename method_to_trait_t<Method>::type;
 
+// Index of the first true condition, or the number of conditions. Lookups
+// with the same pattern of matches share the instantiation.
+template <bool... Conditions> consteval std::size_t first_true() {
+  std::size_t index = 0;
+  static_cast<void>(((Conditions || (++index, false)) || ...));
+  return index;
+}
+
+template <bool... Conditions>
+inline constexpr std::size_t first_true_v = first_true<Conditions...>();
+
+template <typename Method, typename... Methods>
+inline constexpr int index_in_list_v =
+    first_true_v<std::is_same_v<Method, Methods>...> < sizeof...(Methods)
+        ? static_cast<int>(first_true_v<std::is_same_v<Method, Methods>...>)
+        : -1;
+
 template <typename Method, typename... Methods> constexpr int index_in_list() {
-  std::array array = {std::is_same_v<Method, Methods>...};
-  for (int i = 0; i < static_cast<int>(array.size()); ++i)
-    if (array[i])
-      return i;
-  return -1;
+  return index_in_list_v<Method, Methods...>;
 }
 
-template <typename... Methods> struct vtable {
-  constexpr vtable(method_ptr<Methods>... ptrs) : m_functions{ptrs...} {}
+#if defined(__has_builtin)
+#if __has_builtin(__type_pack_element)
+#define ERASED_TYPE_PACK_ELEMENT
+#endif
+#endif
+
+#ifdef ERASED_TYPE_PACK_ELEMENT
+template <std::size_t Index, typename... Ts>
+using type_at_t = __type_pack_element<Index, Ts...>;
+#else
+template <std::size_t Index, typename... Ts>
+using type_at_t = std::tuple_element_t<Index, std::tuple<Ts...>>;
+#endif
+
+// An entry of a vtable, found by its behavior without computing an index
+template <typename Method> struct vtable_entry {
+  constexpr bool operator==(const vtable_entry &) const = default;
+
+  method_ptr<Method> m_value{};
+};
+
+// The entries are bases rather than the elements of a std::tuple, which is
+// cheaper to instantiate. The behaviors of a vtable are distinct.
+template <typename... Methods> struct vtable : vtable_entry<Methods>... {
+  static constexpr std::size_t size = sizeof...(Methods);
+  static constexpr bool all_const =
+      (method_to_trait_t<Methods>::is_const && ...);
+
+  constexpr vtable() = default;
+  constexpr vtable(method_ptr<Methods>... ptrs)
+      : vtable_entry<Methods>{ptrs}... {}
+
+  template <typename T> static constexpr vtable make_for() noexcept {
+    return vtable(
+        method_to_trait_t<Methods>::template create_invoker_for<T>()...);
+  }
 
   template <typename T>
   static constexpr const vtable *construct_for() noexcept {
-    static constexpr vtable vtable(
-        method_to_trait_t<Methods>::template create_invoker_for<T>()...);
+    static constexpr vtable vtable = make_for<T>();
     return &vtable;
   }
 
-  template <typename Method> constexpr auto *get() const noexcept {
-    constexpr int index = index_in_list<Method, Methods...>();
-    return std::get<index>(m_functions);
+  template <typename Method> constexpr auto get() const noexcept {
+    return static_cast<const vtable_entry<Method> &>(*this).m_value;
   }
 
-  std::tuple<method_ptr<Methods>...> m_functions;
+  constexpr bool operator==(const vtable &) const = default;
+};
+
+template <typename... Ts> struct type_list {};
+
+template <typename... Lists> struct concat {
+  using type = type_list<>;
 };
+
+template <typename... Ts> struct concat<type_list<Ts...>> {
+  using type = type_list<Ts...>;
+};
+
+template <typename... As, typename... Bs, typename... Lists>
+struct concat<type_list<As...>, type_list<Bs...>, Lists...>
+    : concat<type_list<As..., Bs...>, Lists...> {};
+
+// Joins eight lists per step, most lists being filtered out behaviors of one
+// or no element
+template <typename... As, typename... Bs, typename... Cs, typename... Ds,
+          typename... Es, typename... Fs, typename... Gs, typename... Hs,
+          typename... Lists>
+struct concat<type_list<As...>, type_list<Bs...>, type_list<Cs...>,
+              type_list<Ds...>, type_list<Es...>, type_list<Fs...>,
+              type_list<Gs...>, type_list<Hs...>, Lists...>
+    : concat<type_list<As..., Bs..., Cs..., Ds..., Es..., Fs..., Gs..., Hs...>,
+             Lists...> {};
+
+template <template <typename...> typename F, typename List> struct apply_list;
+
+template <template <typename...> typename F, typename... Ts>
+struct apply_list<F, type_list<Ts...>> {
+  using type = F<Ts...>;
+};
+
+template <template <typename...> typename F, typename List>
+using apply_list_t = typename apply_list<F, List>::type;
+
+// Policies are given along the behaviors, but do not take part in the vtable.
+struct policy_tag {};
+
+template <typename T>
+concept policy = std::is_base_of_v<policy_tag, T>;
+
+template <typename T, typename Kind>
+concept policy_of = policy<T> && std::is_same_v<typename T::kind, Kind>;
+
+template <bool condition, typename T>
+using keep_if =
+    fast_conditional<condition>::template apply<type_list<T>, type_list<>>;
+
+template <typename... Ts>
+using behaviors_t = typename concat<keep_if<!policy<Ts>, Ts>...>::type;
+
+template <typename Kind, typename Default, typename... Ts>
+using find_policy_t =
+    type_at_t<first_true_v<policy_of<Ts, Kind>...>, Ts..., Default>;
+
+// Static vtables of split_vtable start on their own cache line
+inline constexpr std::size_t cache_line_size = 64;
+
+template <typename Method> struct cold_traits {
+  // Marked by the user, which splits the vtable
+  static constexpr bool is_marked = false;
+  // Kept in the second table of a split vtable
+  static constexpr bool is_cold = false;
+  using type = Method;
+};
+
+template <typename Hot, typename Cold> struct split_vtable;
+
+// The hot entries are stored first, followed by a pointer to the table of the
+// cold ones. Calls to hot entries only touch the first table.
+template <typename... Hot, typename... Cold>
+struct split_vtable<type_list<Hot...>, type_list<Cold...>> {
+  using hot_vtable = vtable<Hot...>;
+  using cold_vtable = vtable<Cold...>;
+
+  static constexpr std::size_t size = sizeof...(Hot) + 1;
+  static constexpr bool all_const =
+      hot_vtable::all_const && cold_vtable::all_const;
+
+  template <typename T> static constexpr split_vtable make_for() noexcept {
+    return {hot_vtable::template make_for<T>(),
+            cold_vtable::template construct_for<T>()};
+  }
+
+  template <typename T>
+  static constexpr const split_vtable *construct_for() noexcept {
+    alignas(cache_line_size) static constexpr split_vtable vtable =
+        make_for<T>();
+    return &vtable;
+  }
+
+  template <typename Method> constexpr auto get() const noexcept {
+    if constexpr (std::is_base_of_v<vtable_entry<Method>, hot_vtable>)
+      return m_hot.template get<Method>();
+    else
+      return m_cold->template get<Method>();
+  }
+
+  constexpr bool operator==(const split_vtable &) const = default;
+
+  hot_vtable m_hot;
+  const cold_vtable *m_cold = nullptr;
+};
+
+template <bool Cold, typename... Methods>
+using split_entries_t =
+    typename concat<keep_if<cold_traits<Methods>::is_cold == Cold,
+                            typename cold_traits<Methods>::type>...>::type;
+
+template <typename... Methods>
+using select_vtable_t =
+    fast_conditional<(cold_traits<Methods>::is_marked || ...)>::template apply<
+        split_vtable<split_entries_t<false, Methods...>,
+                     split_entries_t<true, Methods...>>,
+        vtable<Methods...>>;
+
+template <typename... Ts>
+using vtable_for_t = apply_list_t<select_vtable_t, behaviors_t<Ts...>>;
+
+// The object only stores a pointer to the static vtable of its concrete type.
+template <typename Vtable> struct vtable_pointer {
+  template <typename T>
+  static constexpr vtable_pointer for_type() noexcept {
+    return {Vtable::template construct_for<T>()};
+  }
+
+  template <typename T> constexpr bool holds() const noexcept {
+    return m_ptr == Vtable::template construct_for<T>();
+  }
+
+  constexpr bool empty() const noexcept { return m_ptr == nullptr; }
+
+  constexpr const Vtable *operator->() const noexcept { return m_ptr; }
+
+  constexpr bool operator==(const vtable_pointer &) const = default;
+
+  const Vtable *m_ptr = nullptr;
+};
+
+// The object stores its own copy of the function pointers, which saves the
+// dependent load of the vtable pointer on every call.
+// The concrete type is identified by comparing the function pointers, so
+// linkers folding identical functions (e.g. --icf=all) can make two types
+// compare equal.
+template <typename Vtable> struct vtable_value {
+  template <typename T> static constexpr vtable_value for_type() noexcept {
+    return {Vtable::template make_for<T>()};
+  }
+
+  template <typename T> constexpr bool holds() const noexcept {
+    return m_table == Vtable::template make_for<T>();
+  }
+
+  constexpr bool empty() const noexcept { return m_table == Vtable{}; }
+
+  constexpr const Vtable *operator->() const noexcept { return &m_table; }
+
+  constexpr bool operator==(const vtable_value &) const = default;
+
+  Vtable m_table;
+};
+
+struct layout_kind {};
+
+struct vtable_pointer_layout : policy_tag {
+  using kind = layout_kind;
+
+  template <typename Vtable> using apply = vtable_pointer<Vtable>;
+};
+
+template <typename Vtable, typename... Ts>
+using vtable_layout_t =
+    typename find_policy_t<layout_kind, vtable_pointer_layout,
+                           Ts...>::template apply<Vtable>;
 } // namespace erased::details
@@ -0,0 +1,123 @@
+#include "allocations.h"
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+// Trivial, so that counting needs no dynamic initialization of the thread
+thread_local allocations::counts counted;
+thread_local bool failing = false;
+
+void *allocate(std::size_t size) noexcept {
+  if (failing)
+    return nullptr;
+  ++counted.allocations;
+  counted.bytes += size;
+  return std::malloc(size ? size : 1);
+}
+
+void *allocate(std::size_t size, std::align_val_t alignment) noexcept {
+  if (failing)
+    return nullptr;
+  ++counted.allocations;
+  counted.bytes += size;
+  const auto align = static_cast<std::size_t>(alignment);
+#ifdef _MSC_VER
+  return _aligned_malloc(size ? size : 1, align);
+#else
+  // The size of aligned_alloc is a multiple of the alignment
+  return std::aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+}
+
+void deallocate(void *ptr, std::align_val_t) noexcept {
+#ifdef _MSC_VER
+  _aligned_free(ptr);
+#else
+  std::free(ptr);
+#endif
+}
+
+template <typename... Alignment>
+void *allocate_or_throw(std::size_t size, Alignment... alignment) {
+  if (void *ptr = allocate(size, alignment...))
+    return ptr;
+  throw std::bad_alloc{};
+}
+} // namespace
+
+allocations::counts allocations::current() noexcept { return counted; }
+
+allocations::failure_scope::failure_scope() noexcept { failing = true; }
+
+allocations::failure_scope::~failure_scope() { failing = false; }
+
+void *operator new(std::size_t size) { return allocate_or_throw(size); }
+void *operator new[](std::size_t size) { return allocate_or_throw(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return allocate_or_throw(size, alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return allocate_or_throw(size, alignment);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment,
+                   const std::nothrow_t &) noexcept {
+  return allocate(size, alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept {
+  return allocate(size, alignment);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t alignment) noexcept {
+  deallocate(ptr, alignment);
+}
+
+void operator delete[](void *ptr, std::align_val_t alignment) noexcept {
+  deallocate(ptr, alignment);
+}
+
+void operator delete(void *ptr, std::size_t,
+                     std::align_val_t alignment) noexcept {
+  deallocate(ptr, alignment);
+}
+
+void operator delete[](void *ptr, std::size_t,
+                       std::align_val_t alignment) noexcept {
+  deallocate(ptr, alignment);
+}
+
+void operator delete(void *ptr, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept {
+  deallocate(ptr, alignment);
+}
+
+void operator delete[](void *ptr, std::align_val_t alignment,
+                       const std::nothrow_t &) noexcept {
+  deallocate(ptr, alignment);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts the allocations made through the global operator new, replaced by
+// allocations.cpp, which the Tests and Benchmarks executables link.
+namespace allocations {
+struct counts {
+  std::size_t allocations = 0;
+  std::size_t bytes = 0;
+};
+
+// Allocations of the calling thread since it started
+counts current() noexcept;
+
+// Allocations of the calling thread since the scope was constructed
+class scope {
+public:
+  counts elapsed() const noexcept {
+    const counts now = current();
+    return {now.allocations - m_start.allocations, now.bytes - m_start.bytes};
+  }
+
+private:
+  counts m_start = current();
+};
+
+// Makes the allocations of the calling thread fail while it is alive
+class failure_scope {
+public:
+  failure_scope() noexcept;
+  ~failure_scope();
+
+  failure_scope(const failure_scope &) = delete;
+  failure_scope &operator=(const failure_scope &) = delete;
+};
+} // namespace allocations
@@ -1,6 +1,31 @@
+#include "allocations.h"
+#include <erased/atomic_erased.h>
+#include <erased/closed.h>
 #include <erased/erased.h>
+#include <erased/function.h>
+#include <erased/instrumentation.h>
+#include <erased/invoke_all.h>
+#include <erased/multimethod.h>
+#include <erased/pool.h>
+#include <erased/poly_vector.h>
 #include <erased/ref.h>
+#include <erased/serialization.h>
+#include <erased/shared.h>
+#include <erased/span_ref.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 ERASED_MAKE_BEHAVIOR(ComputeArea, computeArea,
                      (&self) requires(self.computeArea())->double);
@@ -16,6 +41,8 @@ struct Circle {
   constexpr double computeArea() { return radius * radius * 3.14; }
   constexpr double perimeter() const { return radius * 6.28; }
 
+  constexpr bool operator==(const Circle &) const = default;
+
   double radius = 1.0;
 };
 
@@ -23,10 +50,20 @@ struct Rectangle {
   constexpr double computeArea() { return a * b; }
   constexpr double perimeter() const { return 2.0 * (a + b); }
 
+  constexpr bool operator==(const Rectangle &) const = default;
+
   double a = 1.0;
   double b = 1.0;
 };
 
+struct BigCircle {
+  constexpr double computeArea() { return radius * radius * 3.14; }
+  constexpr double perimeter() const { return radius * 6.28; }
+
+  std::array<double, 8> padding{};
+  double radius = 1.0;
+};
+
 using MoveOnlySurface = erased::erased<ComputeArea, Perimeter, erased::Move>;
 using CopyOnlySurface = erased::erased<ComputeArea, Perimeter, erased::Copy>;
 
@@ -129,6 +166,552 @@ struct Square {
   constexpr int compute(int value) const { return value * value; }
 };
 
+using SurfaceVector = erased::poly_vector<ComputeArea, Perimeter>;
+
+constexpr bool polyVectorTest() {
+  SurfaceVector surfaces;
+  surfaces.push_back(Circle(1.0));
+  surfaces.push_back(Rectangle(2.0, 3.0));
+  surfaces.emplace_back<Circle>(2.0);
+
+  std::array<double, 3> areas{};
+  auto *end = surfaces.transform(ComputeArea{}, areas.data());
+
+  return surfaces.size() == 3 && surfaces.segment_count() == 2 &&
+         surfaces.segment_of<Circle>().size() == 2 &&
+         end == areas.data() + areas.size() &&
+         areas[0] == Circle(1.0).computeArea() &&
+         areas[1] == Circle(2.0).computeArea() &&
+         areas[2] == Rectangle(2.0, 3.0).computeArea();
+}
+
+// The batch invoker grows all the circles of a span at once, other types fall
+// back to a loop over the invoker.
+struct Grow {
+  static constexpr void invoker(auto &self, double factor) {
+    self.radius *= factor;
+  }
+
+  static constexpr void batch_invoker(std::span<Circle> circles,
+                                      double factor) {
+    for (auto &circle : circles)
+      circle.radius *= factor;
+  }
+};
+
+using SurfaceSpan = erased::span_ref<ComputeArea, Perimeter, Grow>;
+
+constexpr bool spanRefTest() {
+  std::vector<Circle> circles{Circle(1.0), Circle(2.0)};
+  std::array<BigCircle, 2> bigCircles{};
+  SurfaceSpan circleSpan = circles;
+  SurfaceSpan bigCircleSpan = bigCircles;
+
+  circleSpan.for_each(Grow{}, 2.0);
+  bigCircleSpan.for_each(Grow{}, 3.0);
+
+  std::array<double, 2> perimeters{};
+  std::array<double, 2> areas{};
+  auto *end = circleSpan.transform(Perimeter{}, perimeters.data());
+  bigCircleSpan.transform(ComputeArea{}, areas.data());
+
+  return end == perimeters.data() + perimeters.size() &&
+         circleSpan.size() == 2 && erased::is<Circle>(circleSpan) &&
+         !erased::is<BigCircle>(circleSpan) &&
+         perimeters[0] == Circle(2.0).perimeter() &&
+         perimeters[1] == Circle(4.0).perimeter() &&
+         areas[1] == Circle(3.0).computeArea();
+}
+
+using InlineSurface =
+    erased::basic_erased<64, ComputeArea, Perimeter, erased::Copy,
+                         erased::Move, erased::inline_vtable<6>>;
+using InlineSurfaceRef =
+    erased::ref<ComputeArea, Perimeter, erased::inline_vtable<>>;
+
+static_assert(sizeof(InlineSurface) == 64);
+static_assert(sizeof(InlineSurfaceRef) == 3 * sizeof(void *));
+static_assert(sizeof(SurfaceRef) == 2 * sizeof(void *));
+
+constexpr bool inlineVtableTest() {
+  InlineSurface x = Circle(2.0);
+  InlineSurface y = x;
+  x = Rectangle(3.0);
+
+  Circle circle{1.0};
+  InlineSurfaceRef ref = circle;
+
+  return erased::is<Rectangle>(x) && erased::is<Circle>(y) &&
+         !erased::is<Rectangle>(ref) &&
+         erased::any_cast<Circle>(&ref) == &circle &&
+         x.computeArea() == Rectangle(3.0).computeArea() &&
+         y.perimeter() == Circle(2.0).perimeter() &&
+         ref.computeArea() == Circle(1.0).computeArea();
+}
+
+using ViewSurface = erased::erased<ComputeArea, Perimeter, erased::Copy,
+                                   erased::Move, erased::view<SurfaceRef>>;
+
+constexpr bool projectionTest() {
+  ViewSurface x = Circle(2.0);
+  Surface y = BigCircle{};
+
+  // The vtable of SurfaceRef comes from the view entry of ViewSurface, the
+  // inline vtables are copied from the vtable of Surface by project
+  SurfaceRef ref = x;
+  auto inlineRef = erased::project<InlineSurfaceRef>(y);
+  using PerimeterRef = erased::ref<Perimeter, erased::inline_vtable<>>;
+  auto constRef = erased::project<PerimeterRef>(std::as_const(y));
+
+  // Projected refs follow the stored object, which moves adopt when it is on
+  // the heap, and refs to moved-from objects are empty
+  Surface moved = std::move(y);
+  auto emptyRef = erased::project<InlineSurfaceRef>(y);
+
+  return erased::is<Circle>(ref) && erased::is<BigCircle>(inlineRef) &&
+         erased::is<BigCircle>(constRef) &&
+         erased::any_cast<BigCircle>(&inlineRef) ==
+             erased::any_cast<BigCircle>(&moved) &&
+         !erased::is<BigCircle>(emptyRef) &&
+         erased::any_cast<BigCircle>(&emptyRef) == nullptr &&
+         erased::any_cast<Circle>(&ref) == erased::any_cast<Circle>(&x) &&
+         ref.computeArea() == Circle(2.0).computeArea() &&
+         inlineRef.perimeter() == BigCircle{}.perimeter() &&
+         constRef.perimeter() == BigCircle{}.perimeter();
+}
+
+constexpr bool moveSwapTest() {
+  Surface x = Circle(2.0);
+  Surface y = Rectangle(3.0);
+  swap(x, y);
+
+  Surface z = std::move(x);
+  Surface empty = std::move(x);
+
+  return !x.has_value() && !empty.has_value() && erased::is<Rectangle>(z) &&
+         erased::is<Circle>(y) &&
+         z.computeArea() == Rectangle(3.0).computeArea() &&
+         y.computeArea() == Circle(2.0).computeArea();
+}
+
+constexpr bool assignmentTest() {
+  Surface x = BigCircle{};
+  const Surface y = BigCircle{{}, 2.0};
+  const BigCircle *block = erased::any_cast<BigCircle>(&x);
+  x = y;
+  const bool copyKeepsBlock = erased::any_cast<BigCircle>(&x) == block;
+  BigCircle &emplaced = x.emplace<BigCircle>();
+  emplaced.radius = 3.0;
+
+  Surface z = Circle(1.0);
+  z = Surface(Circle(3.0));
+  z.emplace<Rectangle>(2.0, 3.0);
+
+  return copyKeepsBlock && &emplaced == block &&
+         x.perimeter() == Circle(3.0).perimeter() &&
+         y.perimeter() == Circle(2.0).perimeter() &&
+         z.perimeter() == Rectangle(2.0, 3.0).perimeter();
+}
+
+struct OwningCircle {
+  std::unique_ptr<double> radius = std::make_unique<double>(2.0);
+
+  constexpr double computeArea() const { return Circle(*radius).computeArea(); }
+  constexpr double perimeter() const { return Circle(*radius).perimeter(); }
+};
+
+template <>
+struct erased::is_trivially_relocatable<OwningCircle> : std::true_type {};
+
+using MoveOnlyBigSurface =
+    erased::basic_erased<64, ComputeArea, Perimeter, erased::Move>;
+
+static_assert(erased::is_trivially_relocatable_v<Circle>);
+static_assert(!erased::is_trivially_relocatable_v<Surface>);
+
+using CompactSurface = erased::erased<ComputeArea, Perimeter, erased::Copy,
+                                      erased::Move, erased::compact<>>;
+
+static_assert(sizeof(CompactSurface) == 32);
+static_assert(alignof(CompactSurface) == alignof(void *));
+static_assert(sizeof(std::optional<CompactSurface>) == 40);
+static_assert(alignof(Surface) == 32);
+static_assert(erased::is_trivially_relocatable_v<CompactSurface>);
+static_assert(CompactSurface::report().buffer_size == 24);
+static_assert(CompactSurface::report().compact);
+static_assert(!Surface::report().compact);
+static_assert(CompactSurface::stores_inline<Rectangle>);
+static_assert(CompactSurface::stores_inline<OwningCircle>);
+static_assert(!CompactSurface::stores_inline<BigCircle>);
+
+constexpr bool compactTest() {
+  CompactSurface x = Circle(2.0);
+  CompactSurface y = BigCircle{};
+  swap(x, y);
+
+  CompactSurface z = x;
+  CompactSurface w = std::move(y);
+
+  return !y.has_value() && erased::is<BigCircle>(z) &&
+         erased::is<Circle>(w) &&
+         z.computeArea() == BigCircle{}.computeArea() &&
+         w.perimeter() == Circle(2.0).perimeter();
+}
+
+using InplaceSurface =
+    erased::inplace<32, 8, ComputeArea, Perimeter, erased::Copy, erased::Move>;
+
+static_assert(sizeof(InplaceSurface) == 32);
+static_assert(alignof(InplaceSurface) == 8);
+static_assert(InplaceSurface::report().buffer_size == 24);
+static_assert(InplaceSurface::report().inline_only);
+static_assert(std::is_nothrow_copy_constructible_v<InplaceSurface>);
+static_assert(std::is_nothrow_copy_assignable_v<InplaceSurface>);
+static_assert(InplaceSurface::stores_inline<Rectangle>);
+static_assert(!InplaceSurface::stores_inline<BigCircle>);
+
+constexpr bool inplaceTest() {
+  InplaceSurface x = Circle(2.0);
+  InplaceSurface y = Rectangle(2.0, 3.0);
+  swap(x, y);
+
+  InplaceSurface z = x;
+  InplaceSurface w = std::move(y);
+  z = w;
+
+  return !y.has_value() && erased::is<Circle>(z) && erased::is<Circle>(w) &&
+         x.computeArea() == Rectangle(2.0, 3.0).computeArea() &&
+         z.perimeter() == Circle(2.0).perimeter();
+}
+
+using AreaOnly = erased::erased<ComputeArea, erased::Move>;
+using WideSurface =
+    erased::basic_erased<128, ComputeArea, Perimeter, erased::Copy,
+                         erased::Move, erased::converts_to<AreaOnly>,
+                         erased::converts_to<Surface>>;
+
+static_assert(std::is_nothrow_constructible_v<AreaOnly, WideSurface &&>);
+static_assert(std::is_constructible_v<Surface, const WideSurface &>);
+static_assert(WideSurface::stores_inline<BigCircle>);
+static_assert(!AreaOnly::stores_inline<BigCircle>);
+
+constexpr bool conversionTest() {
+  WideSurface x = Circle(2.0);
+  WideSurface y = BigCircle{};
+  const WideSurface z = Rectangle(2.0, 3.0);
+
+  AreaOnly circle = std::move(x);
+  AreaOnly bigCircle = std::move(y);
+  Surface rectangle = z;
+
+  return !x.has_value() && !y.has_value() && z.has_value() &&
+         erased::is<Circle>(circle) && erased::is<BigCircle>(bigCircle) &&
+         erased::is<Rectangle>(rectangle) &&
+         circle.computeArea() == Circle(2.0).computeArea() &&
+         bigCircle.computeArea() == BigCircle{}.computeArea() &&
+         rectangle.perimeter() == Rectangle(2.0, 3.0).perimeter();
+}
+
+using ComparableSurface =
+    erased::erased<Perimeter, erased::EqualTo, erased::Copy, erased::Move>;
+
+static_assert(ComparableSurface::equality_comparable);
+static_assert(!ComparableSurface::hashable);
+
+constexpr bool equalityTest() {
+  ComparableSurface x = Circle(2.0);
+  ComparableSurface y = x;
+  ComparableSurface z = Circle(3.0);
+  // Same perimeter, but another type
+  ComparableSurface w = Rectangle(3.14, 3.14);
+
+  ComparableSurface moved = Circle(1.0);
+  ComparableSurface other = std::move(moved);
+  ComparableSurface empty = Circle(1.0);
+  ComparableSurface taken = std::move(empty);
+
+  return x == y && !(x == z) && x.perimeter() == w.perimeter() &&
+         !(x == w) && moved == empty && !(moved == other);
+}
+
+// Constants are only called through behaviors taking them by const reference
+using ConstantSurface = erased::erased<Perimeter, erased::Copy, erased::Move>;
+
+// A view of a ref that may modify the object is not allowed on constants
+static_assert(!erased::details::keeps_constants<erased::view<SurfaceRef>,
+                                                ConstantSurface::soo>());
+static_assert(
+    erased::details::keeps_constants<erased::view<erased::ref<Perimeter>>,
+                                     ConstantSurface::soo>());
+
+constexpr bool constantTest() {
+  ConstantSurface circle = erased::constant<Circle{2.0}>;
+  ConstantSurface bigCircle = erased::constant<BigCircle{}>;
+  // Moves adopt the constant, copies construct a Circle
+  ConstantSurface moved = std::move(circle);
+  ConstantSurface copy = moved;
+  swap(copy, bigCircle);
+
+  return !circle.has_value() && erased::is<Circle>(moved) &&
+         erased::is<BigCircle>(copy) && erased::is<Circle>(bigCircle) &&
+         moved.perimeter() == Circle(2.0).perimeter() &&
+         bigCircle.perimeter() == Circle(2.0).perimeter() &&
+         copy.perimeter() == BigCircle{}.perimeter();
+}
+
+constinit ConstantSurface constantSurfaces[] = {
+    erased::constant<Circle{2.0}>, erased::constant<Rectangle{2.0, 3.0}>,
+    erased::constant<BigCircle{}>};
+
+using SurfaceIndex = erased::DispatchIndex<Circle, Rectangle>;
+using DispatchSurface =
+    erased::erased<Perimeter, SurfaceIndex, erased::Copy, erased::Move>;
+using DispatchSurfaceRef = erased::ref<Perimeter, SurfaceIndex>;
+
+// Sum of the perimeters of the pairs involving a Circle, scaled by factor
+struct CirclePerimeters {
+  // Both templates below would be ambiguous for a pair of circles
+  static constexpr double invoker(const Circle &lhs, const Circle &rhs,
+                                  double factor) {
+    return factor * (lhs.perimeter() + rhs.perimeter());
+  }
+
+  template <typename T>
+  static constexpr double invoker(const Circle &lhs, const T &rhs,
+                                  double factor) {
+    return factor * (lhs.perimeter() + rhs.perimeter());
+  }
+
+  template <typename T>
+  static constexpr double invoker(const T &lhs, const Circle &rhs,
+                                  double factor) {
+    return factor * (lhs.perimeter() + rhs.perimeter());
+  }
+
+  static constexpr double fallback(double) { return 0.0; }
+};
+
+constexpr bool multimethodTest() {
+  DispatchSurface circle = Circle(1.0);
+  DispatchSurface rectangle = Rectangle(2.0, 3.0);
+  // Not in the index, as BigCircle
+  DispatchSurface bigCircle = BigCircle{};
+  Rectangle otherRectangle{1.0, 1.0};
+  DispatchSurfaceRef rectangleRef = otherRectangle;
+
+  const auto pair = [](const auto &lhs, const auto &rhs) {
+    return erased::dispatch(CirclePerimeters{}, lhs, rhs, 2.0);
+  };
+
+  return pair(circle, circle) == 4.0 * Circle(1.0).perimeter() &&
+         pair(circle, rectangle) ==
+             2.0 * (Circle(1.0).perimeter() + rectangle.perimeter()) &&
+         pair(rectangleRef, circle) ==
+             2.0 * (otherRectangle.perimeter() + Circle(1.0).perimeter()) &&
+         pair(rectangle, rectangleRef) == 0.0 &&
+         pair(bigCircle, circle) == 0.0 && pair(circle, bigCircle) == 0.0;
+}
+
+using ColdSurface = erased::erased<ComputeArea, erased::cold<Perimeter>,
+                                   erased::Copy, erased::Move>;
+
+// ComputeArea, the type properties and the pointer to the cold table
+static_assert(ColdSurface::report().vtable_entries == 3);
+
+constexpr bool coldTest() {
+  ColdSurface x = Circle(2.0);
+  ColdSurface y = x;
+  ColdSurface z = std::move(x);
+  y = BigCircle{};
+
+  erased::ref<ComputeArea, erased::cold<Perimeter>> ref =
+      *erased::any_cast<BigCircle>(&y);
+
+  return erased::is<BigCircle>(y) && erased::is<Circle>(z) &&
+         !erased::is<Circle>(y) && z.perimeter() == Circle(2.0).perimeter() &&
+         y.computeArea() == BigCircle{}.computeArea() &&
+         ref.perimeter() == BigCircle{}.perimeter();
+}
+
+using ClosedSurface =
+    erased::closed<erased::type_list<Circle, Rectangle, BigCircle>, ComputeArea,
+                   Perimeter, erased::Copy, erased::Move>;
+
+static_assert(sizeof(erased::closed<erased::type_list<Circle, Rectangle>,
+                                    ComputeArea>) == 3 * sizeof(double));
+
+template <typename T, typename Closed>
+concept castable = requires(Closed &object) {
+  erased::is<T>(object);
+  erased::any_cast<T>(&object);
+  erased::any_cast<T>(object);
+};
+
+// Only the types of the closed set are accepted
+static_assert(std::is_constructible_v<ClosedSurface, Circle>);
+static_assert(!std::is_constructible_v<ClosedSurface, double>);
+static_assert(castable<BigCircle, ClosedSurface>);
+static_assert(castable<BigCircle, const ClosedSurface>);
+static_assert(!castable<double, ClosedSurface>);
+static_assert(!castable<double, const ClosedSurface>);
+
+constexpr bool closedTest() {
+  ClosedSurface x = Circle(2.0);
+  ClosedSurface y = BigCircle{};
+  ClosedSurface z = x;
+  z = std::move(y);
+  x = Rectangle(2.0, 3.0);
+
+  return erased::is<Rectangle>(x) && erased::is<BigCircle>(z) &&
+         !erased::is<Circle>(z) && x.index() == 1 &&
+         erased::any_cast<Rectangle>(&x)->b == 3.0 &&
+         erased::any_cast<Circle>(&x) == nullptr &&
+         x.computeArea() == Rectangle(2.0, 3.0).computeArea() &&
+         z.perimeter() == BigCircle{}.perimeter();
+}
+
+// Its copies throw once armed
+struct ThrowingCircle {
+  ThrowingCircle() = default;
+  ThrowingCircle(const ThrowingCircle &other) : armed{other.armed} {
+    if (armed)
+      throw std::runtime_error{"copy"};
+  }
+  ThrowingCircle(ThrowingCircle &&) noexcept = default;
+  ThrowingCircle &operator=(const ThrowingCircle &) = default;
+  ThrowingCircle &operator=(ThrowingCircle &&) noexcept = default;
+
+  double computeArea() { return Circle{}.computeArea(); }
+  double perimeter() const { return Circle{}.perimeter(); }
+
+  bool armed = false;
+};
+
+constexpr bool invokeAllTest() {
+  std::vector<Surface> surfaces;
+  surfaces.push_back(Circle(1.0));
+  surfaces.push_back(Rectangle(2.0, 3.0));
+  surfaces.push_back(BigCircle{});
+  surfaces.push_back(Circle(2.0));
+  surfaces.push_back(Rectangle(1.0, 4.0));
+
+  std::array<double, 5> perimeters{};
+  auto end = erased::invoke_all_into(surfaces, Perimeter{}, perimeters.begin());
+
+  bool inOrder = end == perimeters.end();
+  for (std::size_t i = 0; i < surfaces.size(); ++i)
+    inOrder = inOrder && perimeters[i] == surfaces[i].perimeter();
+  return inOrder && perimeters[1] == Rectangle(2.0, 3.0).perimeter();
+}
+
+using SharedSurface =
+    erased::shared<ComputeArea, Perimeter, Grow, erased::Copy>;
+using SharedMutableSurface = erased::shared<ComputeArea, Perimeter, Grow>;
+
+static_assert(sizeof(SharedSurface) == 3 * sizeof(void *));
+
+constexpr bool sharedTest() {
+  SharedSurface x = BigCircle{};
+  SharedSurface y = x;
+  const bool sharedAfterCopy = x.use_count() == 2;
+
+  // Copy-on-write: y gets its own circle
+  y.invoke(Grow{}, 2.0);
+  const bool detached = x.use_count() == 1 && y.use_count() == 1 &&
+                        x.perimeter() == BigCircle{}.perimeter() &&
+                        erased::any_cast<BigCircle>(y).radius == 2.0;
+
+  SharedMutableSurface z = Circle(1.0);
+  SharedMutableSurface w = z;
+  w.invoke(Grow{}, 3.0);
+  const bool sharedMutation = z.perimeter() == Circle(3.0).perimeter();
+
+  SharedSurface moved = std::move(x);
+
+  return sharedAfterCopy && detached && sharedMutation && !x.has_value() &&
+         erased::is<BigCircle>(moved) && !erased::is<Circle>(moved) &&
+         erased::any_cast<Circle>(&moved) == nullptr;
+}
+
+// Called with one or two arguments, the second overload accumulates
+struct Accumulator {
+  constexpr double operator()(double x) const { return total + x; }
+  constexpr double operator()(double x, double y) { return total += x * y; }
+
+  double total = 0.0;
+};
+
+using Callback =
+    erased::function<double(double) const, double(double, double)>;
+
+static_assert(std::is_copy_constructible_v<Callback>);
+static_assert(std::is_invocable_r_v<double, const Callback &, double>);
+static_assert(!std::is_invocable_v<const Callback &, double, double>);
+static_assert(std::is_invocable_r_v<double, Callback &, double, double>);
+static_assert(
+    !std::is_copy_constructible_v<erased::move_only_function<void()>>);
+static_assert(
+    std::is_nothrow_invocable_v<erased::move_only_function<void() noexcept> &>);
+static_assert(
+    !std::is_nothrow_invocable_v<erased::move_only_function<void()> &>);
+static_assert(sizeof(erased::function_ref<double(double)>) ==
+              2 * sizeof(void *));
+
+constexpr double accumulate(erased::function_ref<double(double, double)> f) {
+  f(1.0, 2.0);
+  return f(3.0, 4.0);
+}
+
+constexpr bool functionTest() {
+  Callback x = Accumulator{};
+  Callback y = x;
+  y(2.0, 3.0);
+
+  erased::move_only_function<double(double) const noexcept> twice =
+      [](double value) noexcept { return 2.0 * value; };
+
+  Accumulator accumulator;
+  const double accumulated = accumulate(accumulator);
+
+  return x(1.0) == 1.0 && y(1.0) == 7.0 && twice(4.0) == 8.0 &&
+         accumulated == 14.0 && accumulator.total == 14.0;
+}
+
+inline int countedAllocations = 0;
+
+template <typename T> struct CountingAllocator {
+  using value_type = T;
+
+  CountingAllocator() = default;
+  template <typename U> CountingAllocator(const CountingAllocator<U> &) {}
+
+  T *allocate(std::size_t n) {
+    ++countedAllocations;
+    return std::allocator<T>{}.allocate(n);
+  }
+
+  void deallocate(T *ptr, std::size_t n) {
+    --countedAllocations;
+    std::allocator<T>{}.deallocate(ptr, n);
+  }
+
+  bool operator==(const CountingAllocator &) const = default;
+};
+
+using AllocatedSurface =
+    erased::erased<ComputeArea, Perimeter, erased::Copy, erased::Move,
+                   erased::allocator<CountingAllocator<std::byte>>>;
+using PmrSurface =
+    erased::basic_erased<64, ComputeArea, Perimeter, erased::Copy,
+                         erased::Move, erased::pmr_allocator>;
+
+using PooledSurface = erased::erased<ComputeArea, Perimeter, erased::Copy,
+                                     erased::Move, erased::pooled>;
+
+static_assert(sizeof(AllocatedSurface) == sizeof(Surface));
+static_assert(sizeof(PooledSurface) == sizeof(Surface));
+static_assert(sizeof(PmrSurface) == 64);
+
 #ifndef _MSC_VER
 TEST(Tests, CompileTimeTestsErased) {
   static_assert(simpleComputation(Circle(2.0)) ==
@@ -155,6 +738,24 @@ TEST(Tests, CompileTimeTestsErased) {
                 Circle(1.0).computeArea() + Circle(1.0).perimeter());
 
   static_assert(castPtrFailTest() == nullptr);
+
+  static_assert(polyVectorTest());
+  static_assert(inlineVtableTest());
+  static_assert(projectionTest());
+  static_assert(moveSwapTest());
+  static_assert(assignmentTest());
+  static_assert(compactTest());
+  static_assert(inplaceTest());
+  static_assert(coldTest());
+  static_assert(conversionTest());
+  static_assert(equalityTest());
+  static_assert(constantTest());
+  static_assert(multimethodTest());
+  static_assert(closedTest());
+  static_assert(invokeAllTest());
+  static_assert(spanRefTest());
+  static_assert(sharedTest());
+  static_assert(functionTest());
 }
 
 constexpr auto simpleComputationRefCircle() {
@@ -233,4 +834,640 @@ TEST(Tests, tests) {
   ASSERT_EQ(castPtrTest(), Circle(1.0).computeArea() + Circle(1.0).perimeter());
 
   ASSERT_EQ(castPtrFailTest(), nullptr);
+
+  ASSERT_TRUE(polyVectorTest());
+  ASSERT_TRUE(inlineVtableTest());
+  ASSERT_TRUE(projectionTest());
+  ASSERT_TRUE(moveSwapTest());
+  ASSERT_TRUE(assignmentTest());
+  ASSERT_TRUE(compactTest());
+  ASSERT_TRUE(inplaceTest());
+  ASSERT_TRUE(coldTest());
+  ASSERT_TRUE(conversionTest());
+  ASSERT_TRUE(equalityTest());
+  ASSERT_TRUE(constantTest());
+  ASSERT_TRUE(multimethodTest());
+  ASSERT_TRUE(closedTest());
+  ASSERT_TRUE(invokeAllTest());
+  ASSERT_TRUE(spanRefTest());
+  ASSERT_TRUE(sharedTest());
+  ASSERT_TRUE(functionTest());
+}
+
+static int addOne(int value) { return value + 1; }
+
+TEST(Tests, FunctionTests) {
+  erased::move_only_function<int()> owning = [value =
+                                                  std::make_unique<int>(42)] {
+    return *value;
+  };
+  auto moved = std::move(owning);
+  ASSERT_FALSE(owning.has_value());
+  ASSERT_EQ(moved(), 42);
+
+  int calls = 0;
+  erased::basic_function<64, erased::type_list<int()>, erased::Copy> counter =
+      [&calls, padding = std::array<int, 8>{}] {
+        return calls += 1 + padding[0];
+      };
+  auto copy = counter;
+  ASSERT_EQ(copy(), 1);
+  ASSERT_EQ(counter(), 2);
+
+  // A function is an erased type, and a function_ref refers to its callable
+  auto increment = [](int value) { return value + 1; };
+  erased::function<int(int) const> incrementer = increment;
+  ASSERT_NE(erased::any_cast<decltype(increment)>(&incrementer), nullptr);
+  ASSERT_EQ(erased::any_cast<decltype(increment)>(incrementer)(1), 2);
+  const erased::function_ref<int(int) const> incrementerRef = incrementer;
+  ASSERT_TRUE(erased::is<decltype(increment)>(incrementerRef));
+  ASSERT_EQ(incrementerRef(1), 2);
+  erased::function_ref<int()> counterRef = counter;
+  ASSERT_EQ(counterRef(), 3);
+
+  // Does not point at the temporary pointer
+  erased::function_ref<int(int)> fromPointer = &addOne;
+  erased::function_ref<int(int)> fromFunction = addOne;
+  ASSERT_EQ(fromPointer(1), 2);
+  ASSERT_EQ(fromFunction(2), 3);
+}
+
+// Serializes its name, and is not trivially copyable
+struct NamedCircle {
+  constexpr double computeArea() { return Circle(radius).computeArea(); }
+  constexpr double perimeter() const { return Circle(radius).perimeter(); }
+
+  void serialize(std::vector<std::byte> &archive) const {
+    const auto *bytes = reinterpret_cast<const std::byte *>(name.data());
+    archive.insert(archive.end(), bytes, bytes + name.size());
+    const auto *radiusBytes = reinterpret_cast<const std::byte *>(&radius);
+    archive.insert(archive.end(), radiusBytes, radiusBytes + sizeof(radius));
+  }
+
+  static NamedCircle deserialize(std::span<const std::byte> payload) {
+    NamedCircle circle;
+    const auto nameSize = payload.size() - sizeof(double);
+    circle.name.assign(reinterpret_cast<const char *>(payload.data()),
+                       nameSize);
+    std::memcpy(&circle.radius, payload.data() + nameSize, sizeof(double));
+    return circle;
+  }
+
+  std::string name;
+  double radius = 1.0;
+};
+
+using SurfaceRegistry = erased::type_registry<Circle, Rectangle, NamedCircle>;
+using SerializableSurface =
+    erased::erased<ComputeArea, Perimeter, erased::Serialize,
+                   erased::StableId<SurfaceRegistry>, erased::Move>;
+
+static_assert(SurfaceRegistry::id<Circle> == 0);
+static_assert(SurfaceRegistry::id<NamedCircle> == 2);
+
+TEST(Tests, ClosedTests) {
+  using ThrowingSurface =
+      erased::closed<erased::type_list<Circle, ThrowingCircle>, ComputeArea,
+                     Perimeter, erased::Copy, erased::Move>;
+  ThrowingSurface circle = Circle(2.0);
+  ThrowingSurface throwing = ThrowingCircle{};
+  erased::any_cast<ThrowingCircle>(throwing).armed = true;
+
+  // A throwing copy leaves the assigned object as it was
+  ASSERT_THROW(circle = throwing, std::runtime_error);
+  ASSERT_TRUE(erased::is<Circle>(circle));
+  ASSERT_EQ(circle.perimeter(), Circle(2.0).perimeter());
+  ASSERT_THROW(ThrowingSurface{throwing}, std::runtime_error);
+}
+
+TEST(Tests, SerializationTests) {
+  std::vector<std::byte> archive;
+  SurfaceRegistry::save(SerializableSurface{Circle(2.0)}, archive);
+  SurfaceRegistry::save(SerializableSurface{Rectangle(2.0, 3.0)}, archive);
+  SurfaceRegistry::save(SerializableSurface{NamedCircle{"circle", 3.0}},
+                        archive);
+  ASSERT_EQ(archive.size() % erased::archive_alignment, 0u);
+
+  std::vector<SerializableSurface> loaded;
+  std::vector<double> viewed;
+  erased::for_each_record(archive, [&](std::span<const std::byte> record) {
+    loaded.push_back(SurfaceRegistry::load<SerializableSurface>(record));
+    try {
+      viewed.push_back(
+          SurfaceRegistry::view<erased::ref<Perimeter>>(record).perimeter());
+    } catch (const erased::archive_error &) {
+      viewed.push_back(0.0);
+    }
+  });
+
+  ASSERT_EQ(loaded.size(), 3u);
+  ASSERT_TRUE(erased::is<Circle>(loaded[0]));
+  ASSERT_TRUE(erased::is<Rectangle>(loaded[1]));
+  ASSERT_EQ(erased::any_cast<NamedCircle>(loaded[2]).name, "circle");
+  ASSERT_EQ(loaded[2].perimeter(), Circle(3.0).perimeter());
+
+  // Trivially copyable objects are viewed in place, the others are not
+  ASSERT_EQ(viewed[0], Circle(2.0).perimeter());
+  ASSERT_EQ(viewed[1], Rectangle(2.0, 3.0).perimeter());
+  ASSERT_EQ(viewed[2], 0.0);
+
+  // The view points inside the archive
+  auto view = SurfaceRegistry::view<SurfaceRef>(std::span{archive});
+  void *payload = archive.data() + sizeof(erased::record_header);
+  ASSERT_EQ(static_cast<void *>(erased::any_cast<Circle>(&view)), payload);
+
+  // A const archive is viewed as the concrete types too
+  const auto constView = SurfaceRegistry::view<erased::ref<Perimeter>>(
+      std::span<const std::byte>{archive});
+  ASSERT_TRUE(erased::is<Circle>(constView));
+  ASSERT_EQ(static_cast<const void *>(erased::any_cast<Circle>(&constView)),
+            payload);
+
+  // Read at an offset of 8 or 4 bytes, as in a shared memory segment,
+  // objects are loaded, but only viewed where they are aligned
+  for (const std::size_t offset : {8u, 4u}) {
+    std::vector<std::byte> shifted(offset);
+    shifted.insert(shifted.end(), archive.begin(), archive.end());
+    const auto record = std::span{shifted}.subspan(offset);
+    const auto circle = SurfaceRegistry::load<SerializableSurface>(record);
+    ASSERT_EQ(circle.perimeter(), Circle(2.0).perimeter());
+    if (offset % alignof(Circle) == 0)
+      ASSERT_EQ(SurfaceRegistry::view<SurfaceRef>(record).perimeter(),
+                Circle(2.0).perimeter());
+    else
+      ASSERT_THROW(SurfaceRegistry::view<SurfaceRef>(record),
+                   erased::archive_error);
+  }
+
+  archive.resize(archive.size() - erased::archive_alignment);
+  ASSERT_THROW(erased::for_each_record(archive, [](auto) {}),
+               erased::archive_error);
+}
+
+TEST(Tests, ConversionTests) {
+  using HeapSurface = erased::erased<ComputeArea, Perimeter, erased::Move,
+                                     erased::converts_to<AreaOnly>>;
+
+  // Both types store BigCircle on the heap, the object is adopted
+  HeapSurface x = BigCircle{};
+  const auto *object = erased::any_cast<BigCircle>(&x);
+  AreaOnly y = std::move(x);
+  ASSERT_FALSE(x.has_value());
+  ASSERT_EQ(erased::any_cast<BigCircle>(&y), object);
+
+  AreaOnly z = HeapSurface{OwningCircle{}};
+  ASSERT_TRUE(erased::is<OwningCircle>(z));
+  ASSERT_EQ(z.computeArea(), Circle(2.0).computeArea());
+}
+
+// Appends to strings, the only type it is called on
+struct Append {
+  template <typename T> static constexpr void invoker(T &self, char c) {
+    if constexpr (std::is_same_v<T, std::string>)
+      self += c;
+  }
+};
+
+using Key = erased::erased<erased::Hash, erased::EqualTo, erased::Copy,
+                           erased::Move>;
+using CachedKey =
+    erased::basic_erased<64, erased::Hash, erased::EqualTo, erased::Copy,
+                         erased::Move, Append, erased::cached_hash>;
+
+static_assert(CachedKey::soo::caches_hash<std::string>);
+
+template <typename Ref, typename Erased>
+concept projectable =
+    requires(Erased &object) { erased::project<Ref>(object); };
+
+// The calls of a projected ref that may modify the object would leave the
+// cached hash stale
+using AppendRef = erased::ref<Append, erased::inline_vtable<>>;
+static_assert(!projectable<AppendRef, CachedKey>);
+static_assert(
+    projectable<erased::ref<erased::EqualTo, erased::inline_vtable<>>,
+                CachedKey>);
+static_assert(!CachedKey::soo::caches_hash<std::array<char, 41>>);
+
+TEST(Tests, HashTests) {
+  const Key number = 42;
+  const Key text = std::string("hello");
+  ASSERT_EQ(number.hash(), std::hash<int>{}(42));
+  ASSERT_EQ(std::hash<Key>{}(text), std::hash<std::string>{}("hello"));
+
+  std::unordered_set<Key> keys{Key{1}, Key{std::string("1")}, Key{1}};
+  ASSERT_EQ(keys.size(), 2u);
+
+  // Looked up by concrete keys, without constructing erased ones
+  std::unordered_map<Key, int, erased::erased_hash<Key>,
+                     erased::erased_equal_to<Key>>
+      values{{Key{1}, 10}, {Key{std::string("one")}, 20}};
+  ASSERT_EQ(values.find(1)->second, 10);
+  ASSERT_EQ(values.find(std::string("one"))->second, 20);
+  ASSERT_EQ(values.find(1.0), values.end());
+  ASSERT_EQ(values.find(2), values.end());
+
+  // Modified through a behavior, moved, copied or on the heap, the hash
+  // follows the object
+  CachedKey cached = std::string("abc");
+  cached.invoke(Append{}, 'd');
+  ASSERT_EQ(cached.hash(), std::hash<std::string>{}("abcd"));
+  CachedKey moved = std::move(cached);
+  CachedKey copy = moved;
+  ASSERT_EQ(copy.hash(), std::hash<std::string>{}("abcd"));
+  ASSERT_EQ(copy, moved);
+  CachedKey heap = std::string(100, 'a');
+  heap.invoke(Append{}, 'b');
+  ASSERT_EQ(heap.hash(),
+            std::hash<std::string>{}(std::string(100, 'a') + 'b'));
+
+  // Batch calls rehash too, and refs that may modify the object refer to the
+  // erased object, whose calls rehash, and cannot be projected on its string
+  std::vector<CachedKey> cachedKeys;
+  cachedKeys.push_back(std::string("x"));
+  cachedKeys.push_back(std::string("y"));
+  erased::invoke_all(cachedKeys, Append{}, 'z');
+  ASSERT_EQ(cachedKeys[0].hash(), std::hash<std::string>{}("xz"));
+  ASSERT_EQ(cachedKeys[1].hash(), std::hash<std::string>{}("yz"));
+  const AppendRef appender = cachedKeys[0];
+  ASSERT_TRUE(erased::is<CachedKey>(appender));
+}
+
+TEST(Tests, ConstantTests) {
+  ASSERT_EQ(constantSurfaces[0].perimeter(), Circle(2.0).perimeter());
+  ASSERT_EQ(constantSurfaces[1].perimeter(), Rectangle(2.0, 3.0).perimeter());
+  ASSERT_EQ(constantSurfaces[2].perimeter(), BigCircle{}.perimeter());
+  ASSERT_EQ(
+      erased::any_cast<Circle>(std::as_const(constantSurfaces[0])).radius,
+      2.0);
+  // Only const erased objects give the constant
+  ASSERT_EQ(erased::any_cast<Circle>(&constantSurfaces[0]), nullptr);
+  ASSERT_THROW(erased::any_cast<Circle>(constantSurfaces[0]), std::bad_cast);
+  ConstantSurface copy = constantSurfaces[0];
+  ASSERT_NE(erased::any_cast<Circle>(&copy), nullptr);
+
+  // The element is left empty and the constant adopted
+  ConstantSurface moved = std::move(constantSurfaces[0]);
+  ASSERT_FALSE(constantSurfaces[0].has_value());
+  ASSERT_EQ(moved.perimeter(), Circle(2.0).perimeter());
+  constantSurfaces[0] = moved;
+  ASSERT_TRUE(erased::is<Circle>(constantSurfaces[0]));
+
+  // Moving a constant into an object of the same type adopts the constant,
+  // even on another heap, instead of moving from it
+  using PmrConstantSurface =
+      erased::erased<Perimeter, erased::Copy, erased::Move,
+                     erased::pmr_allocator>;
+  std::pmr::monotonic_buffer_resource arena;
+  PmrConstantSurface target(std::allocator_arg, &arena, Circle(1.0));
+  PmrConstantSurface constant = erased::constant<Circle{2.0}>;
+  target = std::move(constant);
+  ASSERT_FALSE(constant.has_value());
+  ASSERT_EQ(erased::any_cast<Circle>(&std::as_const(target)),
+            &erased::details::constant_object<Circle{2.0}>);
+
+  // No hash is cached for constants
+  using ConstantKey =
+      erased::basic_erased<64, erased::Hash, erased::EqualTo, erased::Copy,
+                           erased::Move, erased::cached_hash>;
+  Key key = erased::constant<42>;
+  ConstantKey cachedKey = erased::constant<42>;
+  ASSERT_EQ(key.hash(), std::hash<int>{}(42));
+  ASSERT_EQ(cachedKey.hash(), std::hash<int>{}(42));
+  ASSERT_TRUE(cachedKey == ConstantKey{42});
+}
+
+TEST(Tests, RelocationTests) {
+  MoveOnlyBigSurface x = OwningCircle{};
+  MoveOnlyBigSurface y = std::move(x);
+  ASSERT_FALSE(x.has_value());
+  ASSERT_EQ(y.computeArea(), Circle(2.0).computeArea());
+
+  MoveOnlyBigSurface z = BigCircle{};
+  swap(y, z);
+  ASSERT_TRUE(erased::is<BigCircle>(y));
+  ASSERT_TRUE(erased::is<OwningCircle>(z));
+  ASSERT_EQ(z.perimeter(), Circle(2.0).perimeter());
+
+  x = std::move(z);
+  ASSERT_EQ(x.perimeter(), Circle(2.0).perimeter());
+
+  std::vector<CompactSurface> surfaces;
+  for (int i = 0; i < 10; ++i) {
+    surfaces.emplace_back(Rectangle(2.0, 3.0));
+    surfaces.emplace_back(BigCircle{});
+  }
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(surfaces[2 * i].computeArea(),
+              Rectangle(2.0, 3.0).computeArea());
+    ASSERT_EQ(surfaces[2 * i + 1].computeArea(), BigCircle{}.computeArea());
+  }
+}
+
+TEST(Tests, SharedTests) {
+  const SharedSurface surface = BigCircle{};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&surface] {
+      for (int j = 0; j < 1000; ++j) {
+        SharedSurface copy = surface;
+        ASSERT_EQ(copy.perimeter(), BigCircle{}.perimeter());
+      }
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+  ASSERT_EQ(surface.use_count(), 1u);
+}
+
+TEST(Tests, AtomicErasedTests) {
+  erased::atomic_erased<ComputeArea, Perimeter> surface = Circle(1.0);
+  ASSERT_TRUE(erased::is<Circle>(surface));
+
+  std::atomic<bool> stop = false;
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      while (!stop) {
+        const double perimeter = surface.invoke(Perimeter{});
+        ASSERT_GE(perimeter, Circle(1.0).perimeter());
+      }
+    });
+  }
+  for (int i = 2; i <= 1000; ++i)
+    surface.emplace<Circle>(static_cast<double>(i));
+  stop = true;
+  for (auto &reader : readers)
+    reader.join();
+
+  ASSERT_EQ(surface.invoke(Perimeter{}), Circle(1000.0).perimeter());
+  surface.store(Rectangle(2.0, 3.0));
+  surface.reclaim();
+  ASSERT_TRUE(erased::is<Rectangle>(surface));
+  ASSERT_EQ(surface.invoke(Perimeter{}), Rectangle(2.0, 3.0).perimeter());
+}
+
+using InstrumentedSurface =
+    erased::erased<ComputeArea, Perimeter, erased::Copy, erased::Move,
+                   erased::instrumented>;
+
+std::uint64_t instrumentationCount(std::string_view type,
+                                   std::string_view event) {
+  for (const auto &entry : erased::instrumentation_snapshot())
+    if (entry.type == type && entry.event == event)
+      return entry.count;
+  return 0;
+}
+
+TEST(Tests, InstrumentationTests) {
+  static_assert(sizeof(InstrumentedSurface) == sizeof(Surface));
+  {
+    InstrumentedSurface circle = Circle{};
+    InstrumentedSurface bigCircle = BigCircle{};
+    InstrumentedSurface copy = circle;
+    InstrumentedSurface moved = std::move(bigCircle);
+    for (int i = 0; i < 3; ++i)
+      ASSERT_EQ(copy.perimeter(), Circle{}.perimeter());
+    std::thread{[] {
+      InstrumentedSurface rectangle = Rectangle{};
+      ASSERT_EQ(rectangle.computeArea(), Rectangle{}.computeArea());
+    }}.join();
+  }
+
+  ASSERT_EQ(instrumentationCount("Circle", "construct inline"), 2u);
+  ASSERT_EQ(instrumentationCount("Circle", "copy"), 1u);
+  ASSERT_EQ(instrumentationCount("Circle", "Perimeter"), 3u);
+  ASSERT_EQ(instrumentationCount("Circle", "destroy"), 2u);
+  ASSERT_EQ(instrumentationCount("BigCircle", "construct heap"), 1u);
+  ASSERT_EQ(instrumentationCount("BigCircle", "move"), 1u);
+  ASSERT_EQ(instrumentationCount("BigCircle", "destroy"), 1u);
+  ASSERT_EQ(instrumentationCount("Rectangle", "ComputeArea"), 1u);
+  ASSERT_EQ(erased::instrumentation_snapshot().front().count, 3u);
+
+  // Events whose counter cannot be allocated are not counted, instead of
+  // throwing from noexcept moves and destructors
+  {
+    const allocations::failure_scope failing;
+    InstrumentedSurface rectangle = Rectangle{};
+    InstrumentedSurface moved = std::move(rectangle);
+  }
+  ASSERT_EQ(instrumentationCount("Rectangle", "construct inline"), 1u);
+  ASSERT_EQ(instrumentationCount("Rectangle", "move"), 0u);
+  ASSERT_EQ(instrumentationCount("Rectangle", "destroy"), 1u);
+}
+
+TEST(Tests, RefTests) {
+  // A ref points at the erased object, which it follows through assignments,
+  // and whose calls are counted
+  InstrumentedSurface surface = Circle{};
+  const InlineSurfaceRef ref = surface;
+  surface = Rectangle(2.0, 3.0);
+  const auto calls = instrumentationCount("Rectangle", "Perimeter");
+  ASSERT_TRUE(erased::is<InstrumentedSurface>(ref));
+  ASSERT_EQ(ref.perimeter(), Rectangle(2.0, 3.0).perimeter());
+  ASSERT_EQ(instrumentationCount("Rectangle", "Perimeter"), calls + 1);
+
+  // A projected ref points at the object, until it is replaced, and its calls
+  // bypass the erased object and its counters
+  const auto projected = erased::project<InlineSurfaceRef>(surface);
+  ASSERT_EQ(erased::any_cast<Rectangle>(&projected),
+            erased::any_cast<Rectangle>(&surface));
+  ASSERT_EQ(projected.perimeter(), Rectangle(2.0, 3.0).perimeter());
+  ASSERT_EQ(instrumentationCount("Rectangle", "Perimeter"), calls + 1);
+}
+
+TEST(Tests, AllocatorTests) {
+  {
+    AllocatedSurface x = BigCircle{};
+    AllocatedSurface y = x;
+    AllocatedSurface z = Circle{};
+    ASSERT_EQ(countedAllocations, 2);
+
+    z = std::move(y);
+    ASSERT_EQ(z.perimeter(), BigCircle{}.perimeter());
+  }
+  ASSERT_EQ(countedAllocations, 0);
+
+  std::array<std::byte, 1024> buffer;
+  std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size(),
+                                            std::pmr::null_memory_resource()};
+  PmrSurface x{std::allocator_arg, &arena, BigCircle{}};
+  PmrSurface y = std::move(x);
+  PmrSurface z = y;
+
+  ASSERT_EQ(y.get_allocator().resource(), &arena);
+  ASSERT_EQ(z.get_allocator().resource(), std::pmr::get_default_resource());
+  ASSERT_EQ(y.computeArea(), BigCircle{}.computeArea());
+  ASSERT_EQ(z.computeArea(), BigCircle{}.computeArea());
+}
+
+TEST(Tests, PoolTests) {
+  // BigCircle takes a block of 128 bytes
+  constexpr std::size_t sizeClass = 3;
+  {
+    std::vector<PooledSurface> surfaces;
+    for (int i = 0; i < 1000; ++i) {
+      surfaces.emplace_back(BigCircle{});
+      surfaces.emplace_back(Circle{});
+    }
+    std::vector<PooledSurface> copies = surfaces;
+    ASSERT_EQ(copies.back().perimeter(), Circle{}.perimeter());
+    ASSERT_EQ(copies.front().perimeter(), BigCircle{}.perimeter());
+
+    const auto statistics = erased::pool_snapshot()[sizeClass];
+    ASSERT_EQ(statistics.block_size, 128u);
+    ASSERT_GE(statistics.blocks - statistics.free_blocks, 2000u);
+    ASSERT_EQ(erased::pool_trim(), 0u);
+
+    // Destroyed by another thread, which gives the blocks back on exit
+    std::thread{[surfaces = std::move(surfaces)] {}}.join();
+  }
+
+  ASSERT_GT(erased::pool_trim(), 0u);
+  ASSERT_EQ(erased::pool_snapshot()[sizeClass].slabs, 0u);
+
+  PooledSurface x = BigCircle{};
+  ASSERT_EQ(x.computeArea(), BigCircle{}.computeArea());
+
+  // A thread_local object constructed before the cache of its thread is
+  // destroyed after it, and gives its block straight back to the pool
+  const auto blocksInUse = [] {
+    const auto statistics = erased::pool_snapshot()[sizeClass];
+    return statistics.blocks - statistics.free_blocks;
+  };
+  const auto inUse = blocksInUse();
+  std::thread{[] {
+    thread_local PooledSurface late = Circle{};
+    late = BigCircle{};
+  }}.join();
+  ASSERT_EQ(blocksInUse(), inUse);
+}
+
+TEST(Tests, AllocationTests) {
+  // Inline objects and constants, moved, copied and swapped
+  const allocations::scope inlineScope;
+  {
+    Surface circle = Circle(2.0);
+    Surface moved = std::move(circle);
+    Surface copy = moved;
+    swap(copy, moved);
+    copy = std::move(moved);
+
+    ConstantSurface constant = erased::constant<BigCircle{}>;
+    ConstantSurface movedConstant = std::move(constant);
+    ConstantSurface other = Circle(2.0);
+    swap(movedConstant, other);
+  }
+  const auto inlineCounts = inlineScope.elapsed();
+
+  // Heap objects are adopted by moves
+  const allocations::scope heapScope;
+  {
+    Surface bigCircle = BigCircle{};
+    Surface moved = std::move(bigCircle);
+    Surface copy = moved;
+    swap(copy, moved);
+  }
+  const auto heapCounts = heapScope.elapsed();
+
+  ASSERT_EQ(inlineCounts.allocations, 0u);
+  ASSERT_EQ(heapCounts.allocations, 2u);
+  ASSERT_EQ(heapCounts.bytes, 2 * sizeof(BigCircle));
+}
+
+// Distinct types, N being its perimeter
+template <int N> struct Polygon {
+  double computeArea() { return N; }
+  double perimeter() const { return N; }
+};
+
+TEST(Tests, InvokeAllTests) {
+  // More types than invoke_all has groups, and more elements than a block
+  std::vector<Surface> surfaces;
+  [&]<int... N>(std::integer_sequence<int, N...>) {
+    for (int i = 0; i < 20; ++i)
+      (surfaces.emplace_back(Polygon<N>{}), ...);
+  }(std::make_integer_sequence<int, 20>{});
+  std::vector<double> perimeters(surfaces.size());
+
+  const allocations::scope scope;
+  erased::invoke_all_into(surfaces, Perimeter{}, perimeters.begin());
+  erased::invoke_all(surfaces, ComputeArea{});
+  ASSERT_EQ(scope.elapsed().allocations, 0u);
+
+  for (std::size_t i = 0; i < surfaces.size(); ++i)
+    ASSERT_EQ(perimeters[i], static_cast<double>(i % 20));
+}
+
+// Counts its moves, which a bytewise relocation would skip
+struct MoveCountingCircle {
+  MoveCountingCircle() = default;
+  MoveCountingCircle(const MoveCountingCircle &) = default;
+  MoveCountingCircle(MoveCountingCircle &&other) noexcept
+      : radius(other.radius) {
+    ++moves;
+  }
+  MoveCountingCircle &operator=(const MoveCountingCircle &) = default;
+  MoveCountingCircle &operator=(MoveCountingCircle &&other) noexcept {
+    radius = other.radius;
+    ++moves;
+    return *this;
+  }
+
+  double computeArea() { return Circle(radius).computeArea(); }
+  double perimeter() const { return Circle(radius).perimeter(); }
+
+  static inline int moves = 0;
+  double radius = 1.0;
+};
+
+TEST(Tests, ReassignmentTests) {
+  Surface big = BigCircle{};
+  const Surface otherBig = BigCircle{{}, 2.0};
+  Surface circle = MoveCountingCircle{};
+  Surface otherCircle = MoveCountingCircle{};
+  auto heapCapture = [padding = BigCircle{}] { return padding.radius; };
+  using Task = erased::erased<erased::Copy, erased::Move>;
+  Task task = heapCapture;
+  const Task otherTask = heapCapture;
+  MoveCountingCircle::moves = 0;
+
+  // Objects of the same type are assigned to, or rebuilt in their block
+  const allocations::scope scope;
+  big = otherBig;
+  big.emplace<BigCircle>(BigCircle{{}, 3.0});
+  circle = std::move(otherCircle);
+  task = otherTask;
+  const int assignMoves = MoveCountingCircle::moves;
+
+  // An inline object and a heap object trade places with a single move
+  swap(big, circle);
+  const int swapMoves = MoveCountingCircle::moves - assignMoves;
+  const auto counts = scope.elapsed();
+
+  ASSERT_EQ(counts.allocations, 0u);
+  ASSERT_EQ(assignMoves, 1);
+  ASSERT_EQ(swapMoves, 1);
+  ASSERT_FALSE(otherCircle.has_value());
+  ASSERT_TRUE(erased::is<MoveCountingCircle>(big));
+  ASSERT_EQ(circle.invoke(Perimeter{}), Circle(3.0).perimeter());
+  ASSERT_TRUE(erased::is<decltype(heapCapture)>(task));
+
+  // The instrumentation counts the objects replaced in place as destroyed,
+  // rebuilt in their block or reconstructed when they are not assignable
+  auto inlineCapture = [radius = 1.0] { return radius; };
+  const auto inlineName = erased::details::type_name<decltype(inlineCapture)>();
+  {
+    using InstrumentedTask =
+        erased::erased<erased::Copy, erased::Move, erased::instrumented>;
+    InstrumentedSurface instrumented = BigCircle{};
+    instrumented.emplace<BigCircle>(BigCircle{{}, 3.0});
+    InstrumentedTask instrumentedTask = inlineCapture;
+    const InstrumentedTask otherInstrumentedTask = inlineCapture;
+    instrumentedTask = otherInstrumentedTask;
+  }
+  ASSERT_EQ(instrumentationCount("BigCircle", "construct heap"),
+            instrumentationCount("BigCircle", "destroy"));
+  ASSERT_EQ(instrumentationCount(inlineName, "construct inline"), 3u);
+  ASSERT_EQ(instrumentationCount(inlineName, "destroy"), 3u);
 }